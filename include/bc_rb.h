@@ -0,0 +1,94 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_BC_RB_H
+#define FRANZ_FLOW_BC_RB_H
+
+#include <stdbool.h>
+#include "index.h"
+#include "vs_rb.h"
+
+enum bc_rb_mode {
+    BC_RB_GATED,                        /*  the producer can't overrun the slowest subscriber                       */
+    BC_RB_OVERRUN                       /*  the producer never waits: lagging subscribers detect the loss           */
+};
+
+/**
+ * It holds the configuration of a single producer broadcast ring buffer, with the same record framing of vs_rb.
+ *
+ * Each subscriber has its own position in the trailer and the records are not zeroed by them: they rely on the
+ * producer position to know what can be read.
+ */
+struct bc_rb_t {
+    index_t max_msg_length;
+    index_t producer_intent_position_index;
+    index_t producer_position_index;
+    index_t subscribers_cache_position_index;
+    index_t consumer_park_index;
+    index_t subscriber_positions_index;
+    index_t subscribers;
+    index_t capacity;
+    enum bc_rb_mode mode;
+};
+
+/**
+ * Returns the capacity in bytes of the ring buffer plus the trailer.
+ *
+ * @param requested_capacity    the requested capacity in bytes of the records
+ * @param subscribers           the number of subscribers, each one with its own position in the trailer
+ */
+inline static index_t bc_rb_capacity(const index_t requested_capacity, const index_t subscribers);
+
+inline static bool new_bc_rb(struct bc_rb_t *const header, const index_t length, const index_t subscribers,
+                             const enum bc_rb_mode mode);
+
+inline static uint64_t bc_rb_load_producer_position(const struct bc_rb_t *const header, const uint8_t *const buffer);
+
+inline static uint64_t bc_rb_load_subscriber_position(const struct bc_rb_t *const header, const uint8_t *const buffer,
+                                                      const index_t subscriber);
+
+inline static _Atomic uint32_t *bc_rb_consumer_park_word(const struct bc_rb_t *const header, uint8_t *const buffer);
+
+/**
+ * Try to claim a record with zero copy semantics: only one producer is allowed.
+ *
+ * @param claimed_position      the position of the claimed record, to be used to commit it
+ * @param claimed_index         the index of the claimed record: the content is at {@code vs_rb_encoded_msg_offset}
+ * @returns                     {@code true} if claimed, {@code false} if the slowest subscriber is too far behind
+ */
+inline static bool bc_rb_try_claim(const struct bc_rb_t *const header, uint8_t *const buffer,
+                                   const index_t required_capacity,
+                                   uint64_t *const claimed_position, index_t *const claimed_index);
+
+/**
+ * Commit the claimed record making it visible to all the subscribers.
+ */
+inline static bool bc_rb_commit_claim(const struct bc_rb_t *const header, uint8_t *const buffer,
+                                      const uint64_t claimed_position, const uint32_t msg_type_id,
+                                      const index_t msg_content_length);
+
+/**
+ * Read with zero copy semantics up to {@code count} messages for a subscriber of a {@code BC_RB_GATED} ring buffer.
+ */
+inline static uint32_t bc_rb_read(const struct bc_rb_t *const header, uint8_t *const buffer,
+                                  const index_t subscriber,
+                                  const vs_rb_message_consumer consumer,
+                                  const uint32_t count, void *const context);
+
+/**
+ * Read up to {@code count} messages for a subscriber of a {@code BC_RB_OVERRUN} ring buffer.
+ *
+ * Each message is copied into {@code scratch} and validated against the producer before being passed to the
+ * consumer. If the subscriber has been lapped it skips to the producer position.
+ *
+ * @param scratch               a buffer of at least {@code header->max_msg_length} bytes
+ * @param lost_bytes            incremented with the bytes lost because of the producer overrun
+ */
+inline static uint32_t bc_rb_read_overrun(const struct bc_rb_t *const header, uint8_t *const buffer,
+                                          const index_t subscriber,
+                                          const vs_rb_message_consumer consumer,
+                                          const uint32_t count, void *const context,
+                                          uint8_t *const scratch, uint64_t *const lost_bytes);
+
+#endif //FRANZ_FLOW_BC_RB_H
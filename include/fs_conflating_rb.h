@@ -0,0 +1,83 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_FS_CONFLATING_RB_H
+#define FRANZ_FLOW_FS_CONFLATING_RB_H
+
+#include <stdbool.h>
+#include "index.h"
+#include "fs_rb.h"
+
+/**
+ * A single producer single consumer fixed message size ring buffer that conflates the messages by key.
+ *
+ * It uses the slot layout of a fs_rb (a 4 bytes message state followed by the message), but each message starts with
+ * a 4 bytes key: an offer for a key that has a message not consumed yet overwrites it in place, hence the consumer
+ * reads only the latest message of each key and its work is bounded by the number of distinct keys.
+ * The message state of each slot arbitrates between the in place overwrite and the consume of it: if the consumer
+ * wins, the offer is published into a new slot.
+ * The trailer holds the position of the pending message of each key too, used only by the producer: a zeroed ring
+ * buffer is a valid empty one.
+ */
+struct fs_conflating_rb_t {
+    uint8_t *producer_position;         /*  producer position sequence                              [not readable]      */
+    uint8_t *consumer_position;         /*  consumer position sequence                              [not readable]      */
+    uint8_t *consumer_park;             /*  word on which a parked consumer sleeps                  [not readable]      */
+    uint8_t *counters;                  /*  hot-path counters, see {@code enum rb_counter}          [not readable]      */
+    uint8_t *pending_positions;         /*  position + 1 of the pending message of each key         [not readable]      */
+    index_t mask;                       /*  ===(capacity-1) used to speed up modulus operations     [readable]          */
+    index_t capacity;                   /*  max number of messages contained in the ring_buffer     [readable]          */
+    uint32_t aligned_message_size;      /*  real size in bytes of each slot                         [readable]          */
+    uint32_t message_size;              /*  size in bytes of the message of each slot, key excluded [readable]          */
+    uint32_t keys;                      /*  the keys are in [0, keys)                               [readable]          */
+};
+
+/**
+ * Returns the capacity in bytes of the ring buffer plus the trailer.
+ *
+ * @param requested_capacity    the max number of messages the ring buffer can hold
+ * @param message_size          the size in bytes of each message, key excluded
+ * @param keys                  the number of distinct keys
+ */
+static inline index_t
+fs_conflating_rb_capacity(const index_t requested_capacity, const uint32_t message_size, const uint32_t keys);
+
+static inline bool
+new_fs_conflating_rb(uint8_t *const buffer, struct fs_conflating_rb_t *const header,
+                     const index_t requested_capacity, const uint32_t message_size, const uint32_t keys);
+
+/**
+ * Offer the latest message of a key: if the previous message of the key isn't consumed yet it is overwritten.
+ *
+ * @param message               the {@code header->message_size} bytes of the message, copied into the ring buffer
+ * @returns                     {@code false} if the key isn't valid or a new slot is needed and the ring buffer is full
+ */
+static inline bool fs_conflating_rb_offer(uint8_t *const buffer, const struct fs_conflating_rb_t *const header,
+                                          const uint32_t key, const uint8_t *const message);
+
+typedef bool(*const fs_conflating_rb_message_consumer)(const uint32_t, const uint8_t *const, void *const);
+
+/**
+ * Read up to {@code count} messages, passing to the consumer the key and the message of each one.
+ *
+ * @returns                     the number of consumed messages
+ */
+static inline uint32_t fs_conflating_rb_read(uint8_t *const buffer, const struct fs_conflating_rb_t *const header,
+                                             const fs_conflating_rb_message_consumer consumer,
+                                             const uint32_t count, void *const context);
+
+static inline index_t fs_conflating_rb_size(const struct fs_conflating_rb_t *const header);
+
+/**
+ * The word on which a consumer using a {@code PARK_WAIT} wait strategy can sleep.
+ */
+static inline _Atomic uint32_t *fs_conflating_rb_consumer_park_word(const struct fs_conflating_rb_t *const header);
+
+/**
+ * The hot-path counters of the ring buffer (see {@code enum rb_counter}), to be read with {@code rb_counter_load}.
+ * They are updated only if {@code FRANZ_FLOW_COUNTERS} is defined.
+ */
+static inline const uint8_t *fs_conflating_rb_counters(const struct fs_conflating_rb_t *const header);
+
+#endif //FRANZ_FLOW_FS_CONFLATING_RB_H
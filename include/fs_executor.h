@@ -0,0 +1,109 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_FS_EXECUTOR_H
+#define FRANZ_FLOW_FS_EXECUTOR_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "index.h"
+#include "fs_rb.h"
+#include "rb_alloc.h"
+#include "wait_strategy.h"
+
+#define FS_EXECUTOR_MAX_WORKERS 64
+
+struct fs_executor_worker_t;
+
+/**
+ * A task: it can spawn other tasks on the worker that is running it with {@code fs_executor_spawn}.
+ */
+typedef void(*fs_executor_task_function)(struct fs_executor_worker_t *const, void *const);
+
+struct fs_executor_task_t {
+    fs_executor_task_function run;
+    void *argument;
+};
+
+/**
+ * A bounded work-stealing deque of tasks, with the layout of a fs_rb: 16 bytes slots followed by a trailer with the
+ * positions on their own cache lines.
+ * Its worker pushes and takes tasks on the bottom (LIFO, the most recent tasks are still in its caches) while the
+ * other workers steal them from the top (FIFO, the oldest ones).
+ */
+struct fs_executor_deque_t {
+    uint8_t *slots;
+    uint8_t *top;                       /*  position of the next task to be stolen                  [not readable]      */
+    uint8_t *bottom;                    /*  position of the next task to be pushed                  [not readable]      */
+    index_t mask;                       /*  ===(capacity-1) used to speed up modulus operations     [readable]          */
+    index_t capacity;                   /*  max number of tasks contained in the deque              [readable]          */
+};
+
+struct fs_executor_worker_t {
+    struct fs_executor_t *executor;
+    struct fs_executor_deque_t deque;
+    struct wait_strategy_t wait_strategy;
+    uint64_t victim_seed;               /*  xorshift state used to pick the first worker to steal from              */
+    uint32_t index;
+    pthread_t thread;
+};
+
+/**
+ * A fixed pool of worker threads running tasks.
+ *
+ * Each worker runs the tasks of its own deque first, then the ones submitted by external threads through the
+ * injection queue, a fs_mpmc_rb shared by all the workers, and at last it steals from the other workers' deques.
+ * When none of them has any task, the worker waits with its wait strategy: with {@code PARK_WAIT} it sleeps on the
+ * park word of the injection queue, shared by all the workers, that are all unparked on each submit or spawn.
+ * All the deques and the injection queue are in a single mapping.
+ */
+struct fs_executor_t {
+    struct fs_executor_worker_t workers[FS_EXECUTOR_MAX_WORKERS];
+    uint32_t worker_count;
+    uint32_t started_workers;           /*  workers with a running thread, to be joined on stop                     */
+    struct fs_rb_t injection;
+    uint8_t *injection_buffer;
+    struct rb_alloc_t memory;
+    _Atomic bool running;
+};
+
+/**
+ * Allocate the deques and the injection queue of an executor: its workers are started by {@code fs_executor_start}.
+ *
+ * @param deque_capacity        the max number of tasks in the deque of each worker
+ * @param injection_capacity    the max number of tasks submitted and not yet taken by any worker, at least 2
+ * @param wait_strategy         used by the idle workers: with {@code PARK_WAIT} its park word and condition are
+ *                              replaced with the executor ones
+ */
+static inline bool new_fs_executor(struct fs_executor_t *const executor, const uint32_t workers,
+                                   const index_t deque_capacity, const index_t injection_capacity,
+                                   const struct wait_strategy_t *const wait_strategy);
+
+static inline bool fs_executor_start(struct fs_executor_t *const executor);
+
+/**
+ * Submit a task from any thread.
+ *
+ * @returns                     {@code false} if the injection queue is full
+ */
+static inline bool fs_executor_submit(struct fs_executor_t *const executor, const fs_executor_task_function run,
+                                      void *const argument);
+
+/**
+ * Spawn a task from a task running on {@code worker}: it is pushed on the worker's deque, or on the injection queue
+ * if the deque is full.
+ *
+ * @returns                     {@code false} if both of them are full
+ */
+static inline bool fs_executor_spawn(struct fs_executor_worker_t *const worker, const fs_executor_task_function run,
+                                     void *const argument);
+
+/**
+ * Stop the workers after the task they are running, join them and release the executor memory: the tasks not
+ * started yet are never run. It can be called on an executor never started too, just to release its memory.
+ */
+static inline void fs_executor_stop(struct fs_executor_t *const executor);
+
+#endif //FRANZ_FLOW_FS_EXECUTOR_H
@@ -0,0 +1,64 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_FS_MPMC_RB_H
+#define FRANZ_FLOW_FS_MPMC_RB_H
+
+#include <stdbool.h>
+#include "index.h"
+#include "fs_rb.h"
+
+/**
+ * A multi producer multi consumer fixed message size ring buffer.
+ *
+ * It uses the same layout and configuration of a fs_rb: it must be sized with {@code fs_rb_capacity} and initialized
+ * with {@code new_fs_mpmc_rb}, but the 4 bytes message state of each slot holds a sequence relative to the slot index
+ * (ie {@code lap * capacity} when free and {@code lap * capacity + 1} when committed) that allows many consumers
+ * to claim messages by CAS on the consumer position.
+ * A zeroed ring buffer is a valid empty one.
+ * It can't be mixed with the single consumer fs_rb functions.
+ */
+
+/**
+ * As {@code new_fs_rb}, but it needs at least 2 slots: with a single one the committed state of a lap would be the
+ * free state of the next one.
+ *
+ * @returns                     {@code false} if {@code requested_capacity} is less than 2
+ */
+static inline bool new_fs_mpmc_rb(
+        uint8_t *const buffer,
+        struct fs_rb_t *const header,
+        const index_t requested_capacity,
+        const uint32_t message_size);
+
+/**
+ * Try to claim a new slot inside the ring buffer into which the caller can write a message with zero copy semantics.
+ *
+ * After writing the message, the caller must call {@code fs_mpmc_rb_commit_claim} to make it available to be consumed.
+ *
+ * @param buffer                a {@code NOT NULL} buffer's pointer to the ring buffer data + trailer
+ * @param header                a {@code NOT NULL} header's pointer initialized by {@code new_fs_rb}
+ * @param claimed_message       a pointer to the claimed content of the ring buffer: is aligned to 4 bytes and has size equals to @code{(header->aligned_message_size - 4)}
+ * @returns                     {@code true} if the buffer is not full, {@code false} otherwise
+ */
+static inline bool try_fs_mpmc_rb_claim(
+        uint8_t *const buffer,
+        const struct fs_rb_t *const header,
+        uint8_t **const claimed_message);
+
+static inline void fs_mpmc_rb_commit_claim(const uint8_t *const claimed_message_address);
+
+/**
+ * Claims up to {@code count} committed messages and pass them to the consumer, freeing each slot right after.
+ * Any number of consumers can call it concurrently: each message is consumed by only one of them.
+ *
+ * @returns the number of consumed messages
+ */
+inline static uint32_t fs_mpmc_rb_read(
+        uint8_t *const buffer,
+        const struct fs_rb_t *const header,
+        const fs_rb_message_consumer consumer,
+        const uint32_t count, void *const context);
+
+#endif //FRANZ_FLOW_FS_MPMC_RB_H
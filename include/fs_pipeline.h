@@ -0,0 +1,68 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_FS_PIPELINE_H
+#define FRANZ_FLOW_FS_PIPELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "index.h"
+#include "fs_rb.h"
+
+#define FS_PIPELINE_MAX_STAGES 16
+
+/**
+ * A fs_rb whose messages are processed in place by a chain of stages, each one run by its own consumer: a stage can
+ * read a message only after the previous stage has processed it, and the last stage frees it for the producers.
+ *
+ * The producers use the fs_rb claims on {@code ring}, unchanged: the last stage is its consumer.
+ * Each stage but the last one has its own position, on its own cache lines after the fs_rb trailer, that is the
+ * sequence barrier of the next stage: the messages flow through all the stages without being copied.
+ * A zeroed pipeline is a valid empty one.
+ */
+struct fs_pipeline_t {
+    struct fs_rb_t ring;
+    uint8_t *stage_positions;           /*  positions of the stages before the last one             [not readable]      */
+    uint32_t stages;                    /*  number of stages                                        [readable]          */
+};
+
+/**
+ * The state of a stage, owned by the thread running it.
+ */
+struct fs_pipeline_stage_t {
+    const struct fs_pipeline_t *pipeline;
+    uint8_t *position;                  /*  position of the next message to be processed by the stage               */
+    const uint8_t *barrier_position;    /*  position of the previous stage: NULL for the first stage                */
+    uint64_t barrier_cache_position;    /*  last barrier position read by the stage                                 */
+    uint32_t index;
+};
+
+/**
+ * Returns the capacity in bytes of the ring buffer plus the trailer and the stage positions.
+ */
+static inline index_t
+fs_pipeline_capacity(const index_t requested_capacity, const uint32_t message_size, const uint32_t stages);
+
+static inline bool new_fs_pipeline(uint8_t *const buffer, struct fs_pipeline_t *const pipeline,
+                                   const index_t requested_capacity, const uint32_t message_size,
+                                   const uint32_t stages);
+
+/**
+ * @param index                 the index of the stage, in {@code [0, pipeline->stages)}
+ * @returns                     {@code false} if the index isn't valid
+ */
+static inline bool new_fs_pipeline_stage(const struct fs_pipeline_t *const pipeline,
+                                         struct fs_pipeline_stage_t *const stage, const uint32_t index);
+
+/**
+ * Process up to {@code count} messages already processed by the previous stage: the consumer can modify them in
+ * place, for the next stages.
+ *
+ * @returns                     the number of processed messages
+ */
+static inline uint32_t fs_pipeline_stage_process(uint8_t *const buffer, struct fs_pipeline_stage_t *const stage,
+                                                 const fs_rb_message_consumer consumer,
+                                                 const uint32_t count, void *const context);
+
+#endif //FRANZ_FLOW_FS_PIPELINE_H
@@ -7,6 +7,7 @@
 
 #include <stdbool.h>
 #include "index.h"
+#include "rb_counters.h"
 
 /**
  * It holds the configuration of a fixed message size ring buffer.
@@ -25,6 +26,8 @@ struct fs_rb_t {
     uint8_t *producer_position;         /*  producer position sequence                              [not readable]      */
     uint8_t *consumer_cache_position;   /*  last consumer sequence read by the producer             [not readable]      */
     uint8_t *consumer_position;         /*  consumer position sequence                              [not readable]      */
+    uint8_t *consumer_park;             /*  word on which a parked consumer sleeps                  [not readable]      */
+    uint8_t *counters;                  /*  hot-path counters, see {@code enum rb_counter}          [not readable]      */
     index_t mask;                       /*  ===(capacity-1) used to speed up modulus operations     [readable]          */
     index_t capacity;                   /*  max number of messages contained in the ring_buffer     [readable]          */
     uint32_t aligned_message_size;      /*  real size in bytes of each message                      [readable]          */
@@ -90,6 +93,75 @@ inline static uint32_t fs_rb_read(
         const fs_rb_message_consumer consumer,
         const uint32_t count, void *const context);
 
+/**
+ * Called with the content of a message read from a ring buffer and the one of the slot claimed on the next ring
+ * buffer, to be filled: returns {@code false} to stop the transfer after it.
+ */
+typedef bool(*const fs_rb_message_transfer)(uint8_t *const, uint8_t *const, void *const);
+
+/**
+ * Consume up to {@code count} messages, handing each one off to a slot claimed on the next ring buffer: a pipeline
+ * stage can write its output straight into the next ring buffer, without any intermediate copy.
+ * The caller must be the single consumer of the ring buffer and the single producer of the next one.
+ *
+ * @returns                     the number of transferred messages: it stops at the first message that doesn't find
+ *                              room on the next ring buffer, leaving it unconsumed
+ */
+inline static uint32_t fs_rb_transfer(
+        uint8_t *const buffer,
+        const struct fs_rb_t *const header,
+        uint8_t *const next_buffer,
+        const struct fs_rb_t *const next_header,
+        const uint32_t max_look_ahead_step,
+        const fs_rb_message_transfer transfer,
+        const uint32_t count, void *const context);
+
+/**
+ * The word on which a consumer using a {@code PARK_WAIT} wait strategy can sleep.
+ */
+static inline _Atomic uint32_t *fs_rb_consumer_park_word(const struct fs_rb_t *const header);
+
+/**
+ * The hot-path counters of the ring buffer (see {@code enum rb_counter}), to be read with {@code rb_counter_load}.
+ * They are updated only if {@code FRANZ_FLOW_COUNTERS} is defined.
+ */
+static inline const uint8_t *fs_rb_counters(const struct fs_rb_t *const header);
+
+/**
+ * The state of a non-destructive scan of the messages not consumed yet.
+ */
+struct fs_rb_cursor_t {
+    uint64_t consumer_position;         /*  the consumer position when the scan has started                         */
+    uint64_t position;                  /*  the position after the last scanned message                             */
+};
+
+/**
+ * Start a scan from the consumer position: it can be used only by the consumer.
+ */
+static inline void fs_rb_scan_cursor(const uint8_t *const buffer, const struct fs_rb_t *const header,
+                                     struct fs_rb_cursor_t *const cursor);
+
+/**
+ * Move the cursor to the next committed message without consuming it.
+ *
+ * @param message               filled with the message content address, that must not be modified
+ * @returns                     {@code true} if a message has been found, {@code false} otherwise
+ */
+static inline bool fs_rb_scan_next(uint8_t *const buffer, const struct fs_rb_t *const header,
+                                   struct fs_rb_cursor_t *const cursor, uint8_t **const message);
+
+/**
+ * Consume all the messages before {@code position}, ie the {@code position} of the cursor after having scanned the
+ * last message to be consumed: on success the scan can continue with the same cursor, from the new consumer position.
+ *
+ * @param cursor                the cursor of the scan
+ * @param position              a position reached by the scan, between the cursor's consumer position and its position
+ * @returns                     {@code false} if the position isn't reached by the scan or the consumer position has
+ *                              changed since the scan has started
+ */
+static inline bool fs_rb_commit_scan(uint8_t *const buffer, const struct fs_rb_t *const header,
+                                     struct fs_rb_cursor_t *const cursor, const uint64_t position);
+
 static inline index_t fs_rb_size(const struct fs_rb_t *const header);
 
 #endif //FRANZ_FLOW_FIXED_SIZE_RING_BUFFER_H
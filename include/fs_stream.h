@@ -7,6 +7,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "rb_counters.h"
 
 struct fs_stream_t {
     uint8_t *buffer;
@@ -14,6 +15,8 @@ struct fs_stream_t {
     _Atomic uint32_t *active_cycle_index;
     _Atomic uint64_t *consumer_cache_position;
     _Atomic uint64_t *consumer_position;
+    _Atomic uint32_t *consumer_park;
+    uint8_t *counters;
     uint32_t capacity;
     uint32_t mask;
     uint32_t max_gain;
@@ -40,12 +43,38 @@ static inline bool fs_stream_try_claim(
 
 static inline void fs_stream_commit_claim(const uint8_t *const claimed_message_address);
 
+/**
+ * Claims a message without any back-pressure: when the active cycle rotates on the oldest one, it is overwritten.
+ * A stream written using it must be read only by {@link fs_stream_read_lossy}.
+ *
+ * @param claimed_message the claimed message content address
+ * @param claimed_stamp the stamp to be used to commit the claimed message
+ */
+static inline bool fs_stream_try_overwrite_claim(
+        const struct fs_stream_t *const stream,
+        uint8_t **const claimed_message,
+        uint32_t *const claimed_stamp);
+
+static inline void fs_stream_commit_overwrite_claim(const uint8_t *const claimed_message_address,
+                                                    const uint32_t claimed_stamp);
+
 static inline uint64_t fs_stream_load_producer_position(const struct fs_stream_t *const stream);
 
 static inline uint64_t fs_stream_load_consumer_position(const struct fs_stream_t *const stream);
 
 static inline uint32_t fs_stream_size(const struct fs_stream_t *const stream);
 
+/**
+ * The word on which a consumer using a {@code PARK_WAIT} wait strategy can sleep.
+ */
+static inline _Atomic uint32_t *fs_stream_consumer_park_word(const struct fs_stream_t *const stream);
+
+/**
+ * The hot-path counters of the stream (see {@code enum rb_counter}), to be read with {@code rb_counter_load}.
+ * They are updated only if {@code FRANZ_FLOW_COUNTERS} is defined.
+ */
+static inline const uint8_t *fs_stream_counters(const struct fs_stream_t *const stream);
+
 typedef bool(*const fs_stream_message_consumer)(uint8_t *const, void *const);
 
 inline static uint32_t fs_stream_read(
@@ -55,4 +84,21 @@ inline static uint32_t fs_stream_read(
 
 );
 
+/**
+ * Reads the messages of a stream written by {@link fs_stream_try_overwrite_claim}.
+ * Each message is copied in {@code scratch} and validated before being passed to the consumer: when the consumer
+ * has been lapped by the producers it skips to the oldest cycle still readable, adding the skipped messages to
+ * {@code lost_messages}.
+ * A producer that stalls for a whole lap between a claim and its commit could corrupt the message of the next lap.
+ *
+ * @param scratch the buffer where the message is copied, big enough to contain the message size
+ * @param lost_messages incremented by the number of messages lost
+ */
+inline static uint32_t fs_stream_read_lossy(
+        const struct fs_stream_t *const stream,
+        const fs_stream_message_consumer consumer,
+        const uint32_t count, void *const context,
+        uint8_t *const scratch,
+        uint64_t *const lost_messages);
+
 #endif //FRANZ_FLOW_FIXED_SIZE_STREAM_H
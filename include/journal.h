@@ -0,0 +1,75 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_JOURNAL_H
+#define FRANZ_FLOW_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "index.h"
+#include "vs_rb.h"
+
+#define JOURNAL_MAX_PATH_LENGTH 256
+
+/**
+ * An append only journal of vs_rb records, stored in rolling memory mapped segment files named
+ * {@code <path_prefix>.<segment index>}.
+ *
+ * The segments use the same record framing of a vs_rb: the spans returned by {@code vs_rb_drain} are appended
+ * with bulk copies, without the padding records of the ring buffer, and a padding record fills the end of a segment
+ * when the next record doesn't fit in it. A segment is zero filled after its last record.
+ */
+struct journal_t {
+    char path_prefix[JOURNAL_MAX_PATH_LENGTH];
+    index_t segment_length;             /*  length in bytes of each segment file                                    */
+    uint64_t segment_index;             /*  index of the segment being appended                                     */
+    uint8_t *segment;                   /*  the mapped segment being appended                                       */
+    index_t segment_position;           /*  bytes already appended to the segment                                   */
+};
+
+/**
+ * A mapped segment to be replayed with {@code vs_rb_span_next}, using {@code span}.
+ */
+struct journal_segment_t {
+    uint8_t *buffer;                    /*  the mapped segment, read only                                           */
+    index_t length;                     /*  the mapped length in bytes                                              */
+    struct vs_rb_span_t span;           /*  the span of all the records in the segment                              */
+};
+
+/**
+ * Open a journal, appending after the last record of the last existing segment, if any.
+ *
+ * @param path_prefix           the path prefix of the segment files
+ * @param segment_length        the length in bytes of each segment: a multiple of 8 bytes, able to hold the biggest record
+ * @returns                     {@code true} if opened, {@code false} otherwise
+ */
+static inline bool new_journal(struct journal_t *const journal, const char *const path_prefix,
+                               const index_t segment_length);
+
+/**
+ * Append the records of a span, rolling to new segments if needed: it must be called before releasing the span.
+ *
+ * @returns                     {@code false} if a record can't fit a segment or a new segment can't be created
+ */
+static inline bool journal_append(struct journal_t *const journal, const uint8_t *const buffer,
+                                  const struct vs_rb_span_t *const span);
+
+/**
+ * Flush to the storage the records appended to the current segment: the previous ones are flushed on rolling.
+ */
+static inline bool journal_sync(const struct journal_t *const journal);
+
+static inline bool journal_close(struct journal_t *const journal);
+
+/**
+ * Map a segment to replay it.
+ *
+ * @returns                     {@code false} if the segment doesn't exist
+ */
+static inline bool journal_open_segment(const char *const path_prefix, const uint64_t segment_index,
+                                        struct journal_segment_t *const segment);
+
+static inline bool journal_close_segment(struct journal_segment_t *const segment);
+
+#endif //FRANZ_FLOW_JOURNAL_H
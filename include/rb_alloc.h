@@ -0,0 +1,48 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_RB_ALLOC_H
+#define FRANZ_FLOW_RB_ALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "index.h"
+
+/**
+ * Flags to be used on allocation.
+ */
+#define RB_ALLOC_PREFAULT 1             /*  touch each page after the placement, to not fault on the hot path       */
+#define RB_ALLOC_HUGE_PAGES 2           /*  2MB pages: hugetlbfs if reserved, transparent huge pages otherwise      */
+
+#define RB_ALLOC_ANY_NUMA_NODE -1
+
+/**
+ * A zeroed anonymous private mapping to be used as a ring buffer data + trailer, ie {@code vs_rb_capacity} bytes.
+ *
+ * Placing it on the NUMA node of the cpus running the producers/consumers avoids the trailer cache lines and the
+ * messages to cross the sockets interconnect on each access: the benchmark harness pins the threads and allocates
+ * with the same node to measure it.
+ */
+struct rb_alloc_t {
+    uint8_t *buffer;                    /*  the ring buffer data + trailer                                          */
+    size_t length;                      /*  the mapped length in bytes, >= the requested one                        */
+    bool huge_pages;                    /*  {@code true} if backed by hugetlbfs pages                               */
+};
+
+/**
+ * Map a zeroed buffer.
+ *
+ * @param length                the length in bytes to be allocated
+ * @param numa_node             the NUMA node on which the memory is bound or {@code RB_ALLOC_ANY_NUMA_NODE} to use
+ *                              the default (first-touch) policy
+ * @param flags                 a combination of {@code RB_ALLOC_PREFAULT} and {@code RB_ALLOC_HUGE_PAGES}
+ * @param alloc                 a {@code NOT NULL} pointer, filled with the mapping
+ * @returns                     {@code true} if allocated and bound to the requested node, {@code false} otherwise
+ */
+static inline bool rb_alloc(const index_t length, const int numa_node, const int flags, struct rb_alloc_t *const alloc);
+
+static inline bool rb_free(struct rb_alloc_t *const alloc);
+
+#endif //FRANZ_FLOW_RB_ALLOC_H
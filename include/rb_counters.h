@@ -0,0 +1,59 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_RB_COUNTERS_H
+#define FRANZ_FLOW_RB_COUNTERS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * The hot-path counters of a ring buffer, stored as {@code uint64_t} in a dedicated area of its trailer.
+ *
+ * The area is always reserved, hence the layout doesn't depend on the counters being compiled in or out:
+ * the producers' counters are on the first 2 cache lines and the consumer ones on the next 2, to not add any false
+ * sharing between them.
+ * Not every ring buffer uses all of them: the unused ones are always 0.
+ */
+enum rb_counter {
+    RB_CLAIMS = 0,                      /*  successful claims                                                       */
+    RB_FULL_CLAIMS = 1,                 /*  claims failed because the ring buffer was full                          */
+    RB_PADDING_RECORDS = 2,             /*  padding records emitted at the end of the buffer                        */
+    RB_CONSUMER_CACHE_REFRESHES = 3,    /*  cached consumer position refreshed by a producer                        */
+    RB_CAS_RETRIES = 4,                 /*  failed producer position CAS on multi producer claims                   */
+    RB_CYCLE_ROTATIONS = 5,             /*  active cycle rotations of a fs_stream                                   */
+    RB_CONFLATED_UPDATES = 6,           /*  offers that have overwritten a pending message of the same key          */
+    RB_READS = 16,                      /*  read operations that have consumed at least one message                 */
+    RB_EMPTY_READS = 17                 /*  read operations that haven't found any message                          */
+};
+
+#define RB_COUNTERS_COUNT 32
+#define RB_COUNTERS_LENGTH (RB_COUNTERS_COUNT * 8)
+
+/**
+ * Increments a counter: with {@code FRANZ_FLOW_COUNTERS} not defined it compiles to nothing.
+ *
+ * The increments are relaxed atomic adds: the counters are just informative and can be read by any process
+ * that maps the ring buffer, while it is in use.
+ */
+#ifdef FRANZ_FLOW_COUNTERS
+#define RB_COUNTER_INCREMENT(counters, counter) \
+    atomic_fetch_add_explicit(((_Atomic uint64_t *) (counters)) + (counter), 1, memory_order_relaxed)
+#else
+#define RB_COUNTER_INCREMENT(counters, counter) ((void) (counters))
+#endif
+
+/**
+ * Loads the value of a counter.
+ *
+ * @param counters              the counters area of a ring buffer's trailer
+ */
+static inline uint64_t rb_counter_load(const uint8_t *const counters, const enum rb_counter counter);
+
+/**
+ * The name of a counter, to be used on reports.
+ */
+static inline const char *rb_counter_name(const enum rb_counter counter);
+
+#endif //FRANZ_FLOW_RB_COUNTERS_H
@@ -0,0 +1,61 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_RB_SET_H
+#define FRANZ_FLOW_RB_SET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "index.h"
+
+/**
+ * A readiness bitmap shared between the producers of many ring buffers (of any kind) and their single consumer,
+ * with a bit for each ring buffer: a producer sets it after committing a message, if it isn't already, and the
+ * consumer visits only the ring buffers with the bit set, clearing it before reading them.
+ *
+ * Polling a set of idle ring buffers costs a scan of few packed words instead of a cache miss on the record header
+ * or the message state of each ring buffer.
+ * The ring buffers are identified by their index in the set, starting from 0: a zeroed bitmap has no ring buffer ready.
+ */
+struct rb_set_t {
+    uint8_t *bitmap;                    /*  a bit for each ring buffer, 64 ring buffers for each word               */
+    uint32_t rings;                     /*  the ring buffers in the set                                             */
+    uint32_t words;                     /*  the words of the bitmap                                                 */
+};
+
+/**
+ * Returns the capacity in bytes of the bitmap of a set of {@code rings} ring buffers.
+ */
+static inline index_t rb_set_capacity(const uint32_t rings);
+
+static inline bool new_rb_set(uint8_t *const buffer, struct rb_set_t *const set, const uint32_t rings);
+
+/**
+ * To be called by a producer of a ring buffer of the set after each commit (or batch of commits): it writes the
+ * bitmap only if the ring buffer isn't already marked as ready, ie on its empty to non-empty transition.
+ */
+static inline void rb_set_notify(const struct rb_set_t *const set, const uint32_t ring_id);
+
+/**
+ * Called for each ready ring buffer: it should read it as usual.
+ *
+ * @returns                     {@code true} if the ring buffer could still have messages to be read (eg it has
+ *                              been read up to a batch limit) and must be visited again on the next poll
+ */
+typedef bool(*const rb_set_ring_consumer)(const uint32_t, void *const);
+
+/**
+ * Visit the ready ring buffers, by increasing index.
+ *
+ * @returns                     the number of visited ring buffers
+ */
+static inline uint32_t rb_set_poll(const struct rb_set_t *const set, const rb_set_ring_consumer consumer,
+                                   void *const context);
+
+/**
+ * Returns {@code true} if any ring buffer of the set is ready, without clearing any bit.
+ */
+static inline bool rb_set_is_ready(const struct rb_set_t *const set);
+
+#endif //FRANZ_FLOW_RB_SET_H
@@ -0,0 +1,71 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_SHM_RB_H
+#define FRANZ_FLOW_SHM_RB_H
+
+#include <stdbool.h>
+#include "index.h"
+#include "vs_rb.h"
+#include "fs_rb.h"
+
+enum shm_rb_layout {
+    SHM_VS_RB_LAYOUT = 1,
+    SHM_FS_RB_LAYOUT = 2
+};
+
+/**
+ * Flags to be used on create/attach.
+ */
+#define SHM_RB_POPULATE 1               /*  pre-fault the mapping with MAP_POPULATE                                 */
+#define SHM_RB_HUGE_PAGES 2             /*  advise the kernel to back the mapping with transparent huge pages       */
+#define SHM_RB_READ_ONLY 4              /*  attach only: map read-only, for tools that just observe the ring buffer */
+
+/**
+ * A ring buffer mapped from a shared memory file (ie under /dev/shm).
+ *
+ * The first cache line of the ring buffer trailer (unused by the producers/consumers) holds a self-describing
+ * descriptor with magic, version, layout, capacity and message length, written by the creator and validated by
+ * any process that attaches to it.
+ */
+struct shm_rb_t {
+    uint8_t *buffer;                    /*  the mapped ring buffer data + trailer                                   */
+    index_t length;                     /*  the mapped length in bytes                                              */
+    enum shm_rb_layout layout;          /*  the layout of the mapped ring buffer                                    */
+};
+
+/**
+ * Create (or truncate) the shared memory file and map into it a new vs_rb.
+ * It is in {@code VS_RB_CONTIGUOUS_MODE}: to be written with the wrap claims, it must be switched with
+ * {@code vs_rb_set_wrap_mode} before sharing it.
+ *
+ * @param path                  the shared memory file path
+ * @param requested_capacity    the requested capacity in bytes of the ring buffer
+ * @param flags                 a combination of {@code SHM_RB_POPULATE} and {@code SHM_RB_HUGE_PAGES}
+ * @param shm                   a {@code NOT NULL} pointer, filled with the mapping
+ * @param header                a {@code NOT NULL} header's pointer, initialized as {@code new_vs_rb} does
+ * @returns                     {@code true} if created, {@code false} otherwise
+ */
+static inline bool shm_vs_rb_create(const char *const path, const index_t requested_capacity, const int flags,
+                                    struct shm_rb_t *const shm, struct vs_rb_t *const header);
+
+/**
+ * Map an existing vs_rb, validating its descriptor.
+ * With {@code SHM_RB_READ_ONLY} the mapping can be used only to load positions, counters and records.
+ *
+ * @returns                     {@code true} if attached, {@code false} if the file is missing or is not a valid vs_rb
+ */
+static inline bool shm_vs_rb_attach(const char *const path, const int flags,
+                                    struct shm_rb_t *const shm, struct vs_rb_t *const header);
+
+static inline bool shm_fs_rb_create(const char *const path, const index_t requested_capacity,
+                                    const uint32_t message_size, const int flags,
+                                    struct shm_rb_t *const shm, struct fs_rb_t *const header);
+
+static inline bool shm_fs_rb_attach(const char *const path, const int flags,
+                                    struct shm_rb_t *const shm, struct fs_rb_t *const header);
+
+static inline bool shm_rb_close(struct shm_rb_t *const shm);
+
+#endif //FRANZ_FLOW_SHM_RB_H
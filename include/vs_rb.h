@@ -6,16 +6,48 @@
 #define FRANZ_FLOW_VS_RB_H
 
 #include <stdbool.h>
+#include <sys/uio.h>
 #include "index.h"
+#include "rb_counters.h"
 
 struct vs_rb_t {
     index_t max_msg_length;
     index_t producer_position_index;
     index_t consumer_cache_position_index;
     index_t consumer_position_index;
+    index_t consumer_park_index;
+    index_t counters_index;
+    index_t mode_index;
     index_t capacity;
 };
 
+/**
+ * How the consumed bytes are zeroed before being released to the producers.
+ */
+enum vs_rb_zeroing {
+    VS_RB_ZEROING_TEMPORAL,             /*  plain memset: the zeroed bytes stay in the consumer cache               */
+    VS_RB_ZEROING_NON_TEMPORAL          /*  streaming stores: cheaper for large spans, they bypass the caches       */
+};
+
+/**
+ * How the records are laid out at the end of the buffer: it is stored in the trailer, hence any process mapping the
+ * ring buffer knows how to read it.
+ */
+enum vs_rb_mode {
+    VS_RB_CONTIGUOUS_MODE = 0,          /*  a padding record fills the end of the buffer: contiguous record content */
+    VS_RB_WRAP_MODE = 1                 /*  the content of a record can continue from the start of the buffer       */
+};
+
+/**
+ * A contiguous span of committed records returned by {@code vs_rb_drain}, not yet released to the producers.
+ */
+struct vs_rb_span_t {
+    uint64_t position;                  /*  consumer position of the first record of the span                       */
+    index_t index;                      /*  index of the first record of the span                                   */
+    index_t length;                     /*  length in bytes of the span, padding records included                   */
+    uint32_t msg_count;                 /*  number of messages (not padding records) of the span                    */
+};
+
 inline static index_t vs_rb_required_record_capacity(const index_t record_length);
 
 inline static index_t vs_rb_capacity(const index_t requested_capacity);
@@ -28,6 +60,27 @@ inline static uint64_t vs_rb_load_consumer_position(const struct vs_rb_t *const
 
 inline static uint64_t vs_rb_load_producer_position(const struct vs_rb_t *const header, const uint8_t *const buffer);
 
+/**
+ * The word on which a consumer using a {@code PARK_WAIT} wait strategy can sleep.
+ */
+inline static _Atomic uint32_t *vs_rb_consumer_park_word(const struct vs_rb_t *const header, uint8_t *const buffer);
+
+/**
+ * The hot-path counters of the ring buffer (see {@code enum rb_counter}), to be read with {@code rb_counter_load}.
+ * They are updated only if {@code FRANZ_FLOW_COUNTERS} is defined.
+ */
+inline static const uint8_t *vs_rb_counters(const struct vs_rb_t *const header, const uint8_t *const buffer);
+
+/**
+ * Switch a ring buffer to {@code VS_RB_WRAP_MODE}: it must be done before any record is claimed and before any
+ * producer or consumer starts to use it.
+ *
+ * @returns                     {@code false} if any record has been already claimed
+ */
+inline static bool vs_rb_set_wrap_mode(const struct vs_rb_t *const header, uint8_t *const buffer);
+
+inline static enum vs_rb_mode vs_rb_load_mode(const struct vs_rb_t *const header, const uint8_t *const buffer);
+
 inline static bool
 vs_rb_try_mp_claim(const struct vs_rb_t *const header, const uint8_t *const buffer,
                    const index_t required_capacity,
@@ -38,19 +91,214 @@ vs_rb_try_sp_claim(const struct vs_rb_t *const header, const uint8_t *const buff
                    const index_t required_capacity,
                    uint64_t *const claimed_position, index_t *const claimed_index);
 
+/**
+ * Try to claim in a single producer position update the records to hold a batch of messages.
+ *
+ * The batch is claimed all or nothing and if it doesn't fit until the end of the buffer a single padding record
+ * is placed between the records claimed at the end and the ones claimed from the start of the buffer.
+ *
+ * @param required_capacities   the content length of each message of the batch
+ * @param count                 the number of messages of the batch
+ * @param claimed_position      the position of the last claimed record of the batch
+ * @param claimed_indexes       filled with the index of each claimed record, to be used to encode and commit them
+ * @returns                     {@code true} if the batch is claimed, {@code false} otherwise
+ */
+inline static bool
+vs_rb_try_mp_batch_claim(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                         const index_t *const required_capacities, const uint32_t count,
+                         uint64_t *const claimed_position, index_t *const claimed_indexes);
+
+inline static bool
+vs_rb_try_sp_batch_claim(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                         const index_t *const required_capacities, const uint32_t count,
+                         uint64_t *const claimed_position, index_t *const claimed_indexes);
+
+/**
+ * Try to claim a record that, if it doesn't fit until the end of the buffer, continues from the start of it instead
+ * of being preceded by a padding record: no capacity is wasted, but the content of the record could be split in
+ * 2 segments, to be obtained with {@code vs_rb_record_segments}.
+ *
+ * It fails if the ring buffer isn't in {@code VS_RB_WRAP_MODE}, that can be read only by {@code vs_rb_read_segments}:
+ * the other read operations expect a contiguous record content and don't read anything from it.
+ */
+inline static bool
+vs_rb_try_mp_wrap_claim(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                        const index_t required_capacity,
+                        uint64_t *const claimed_position, index_t *const claimed_index);
+
+inline static bool
+vs_rb_try_sp_wrap_claim(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                        const index_t required_capacity,
+                        uint64_t *const claimed_position, index_t *const claimed_index);
+
+#define VS_RB_MAX_SEGMENTS 2
+
+/**
+ * Fill {@code segments} with the content of a record, that could be split between the end and the start of the buffer.
+ *
+ * @param msg_index             the index of the record, ie a claimed index
+ * @param msg_content_length    the length in bytes of the content of the record
+ * @param segments              at least {@code VS_RB_MAX_SEGMENTS} segments: the unused ones are filled as empty
+ * @returns                     the number of segments of the content
+ */
+inline static uint32_t
+vs_rb_record_segments(const struct vs_rb_t *const header, const uint8_t *const buffer, const index_t msg_index,
+                      const index_t msg_content_length, struct iovec *const segments);
+
 inline static bool
 vs_rb_commit_claim(const uint8_t *const buffer, const index_t msg_index, const uint32_t msg_type_id,
                    const index_t msg_content_length);
 
+inline static bool
+vs_rb_commit_batch_claim(const uint8_t *const buffer, const index_t *const msg_indexes,
+                         const uint32_t *const msg_type_ids, const index_t *const msg_content_lengths,
+                         const uint32_t count);
+
+/**
+ * Try to claim a record for a message made of {@code segments}, copy them one after the other into it and
+ * commit it: big messages are copied with non temporal stores.
+ *
+ * @returns                     {@code false} if the ring buffer is full or the message isn't valid
+ */
+inline static bool
+vs_rb_try_sp_offer(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t msg_type_id,
+                   const struct iovec *const segments, const uint32_t segments_count);
+
+inline static bool
+vs_rb_try_mp_offer(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t msg_type_id,
+                   const struct iovec *const segments, const uint32_t segments_count);
+
+#define VS_RB_MAX_OFFER_BATCH 64
+
+/**
+ * Offer a batch of at most {@code VS_RB_MAX_OFFER_BATCH} messages with a single batch claim: all or nothing.
+ *
+ * @param msg_type_ids          the msg type id of each message
+ * @param messages              the content of each message
+ */
+inline static bool
+vs_rb_try_sp_offer_batch(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t *const msg_type_ids,
+                         const struct iovec *const messages, const uint32_t count);
+
+inline static bool
+vs_rb_try_mp_offer_batch(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t *const msg_type_ids,
+                         const struct iovec *const messages, const uint32_t count);
+
 //declare a const pointer to a function with this signature
 typedef bool(*const vs_rb_message_consumer)(const uint32_t, const uint8_t *const,
                                             const index_t,
                                             const index_t, void *const);
 
+/**
+ * Read up to {@code count} committed messages, passing to the consumer their content as a contiguous range of the
+ * buffer: it doesn't read anything from a ring buffer in {@code VS_RB_WRAP_MODE}.
+ *
+ * @returns                     the number of consumed messages
+ */
 inline static uint32_t vs_rb_read(const struct vs_rb_t *const header, uint8_t *const buffer,
                                   const vs_rb_message_consumer consumer,
                                   const uint32_t count, void *context);
 
+/**
+ * What a {@code vs_rb_controlled_consumer} wants to do with the message it has been passed.
+ */
+enum vs_rb_control_action {
+    VS_RB_ABORT,                        /*  leave the message unconsumed and stop: next read starts from it         */
+    VS_RB_BREAK,                        /*  consume the message and stop                                            */
+    VS_RB_COMMIT,                       /*  consume the message and release to the producers the consumed ones      */
+    VS_RB_CONTINUE                      /*  consume the message and continue                                        */
+};
+
+typedef enum vs_rb_control_action(*const vs_rb_controlled_consumer)(const uint32_t, const uint8_t *const,
+                                                                    const index_t, const index_t, void *const);
+
+/**
+ * As {@code vs_rb_read}, but the consumer controls if each message is consumed and when the consumed bytes are
+ * released to the producers: the consumed messages are released at the end of the read or on a {@code VS_RB_COMMIT}.
+ *
+ * @returns                     the number of consumed messages
+ */
+inline static uint32_t vs_rb_controlled_read(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                             const vs_rb_controlled_consumer consumer,
+                                             const uint32_t count, void *context);
+
+typedef bool(*const vs_rb_segments_consumer)(const uint32_t, const struct iovec *const, const uint32_t,
+                                             void *const);
+
+/**
+ * As {@code vs_rb_read}, but the content of each message is passed to the consumer as segments, to read the records
+ * claimed by {@code vs_rb_try_sp_wrap_claim}/{@code vs_rb_try_mp_wrap_claim} too.
+ */
+inline static uint32_t vs_rb_read_segments(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                           const vs_rb_segments_consumer consumer,
+                                           const uint32_t count, void *context);
+
+/**
+ * Collect up to {@code count} committed messages starting from the consumer position, stopping on the first
+ * not committed record or at the end of the buffer, without consuming them: as {@code vs_rb_read}, it doesn't
+ * collect anything from a ring buffer in {@code VS_RB_WRAP_MODE}.
+ *
+ * The messages can be iterated with {@code vs_rb_span_next} and must be released with {@code vs_rb_release_span}
+ * before calling any other read operation.
+ *
+ * @returns                     the number of messages in the span
+ */
+inline static uint32_t vs_rb_drain(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                                   const uint32_t count, struct vs_rb_span_t *const span);
+
+/**
+ * Iterate the messages of a span, skipping padding records.
+ *
+ * @param span_offset           the iteration state: must be 0 on the first call
+ * @returns                     {@code true} if a message has been found, {@code false} at the end of the span
+ */
+inline static bool vs_rb_span_next(const uint8_t *const buffer, const struct vs_rb_span_t *const span,
+                                   index_t *const span_offset, uint32_t *const msg_type_id,
+                                   index_t *const msg_content_index, index_t *const msg_content_length);
+
+/**
+ * Zeroes the whole span in bulk and release it to the producers with a single consumer position update.
+ */
+inline static void vs_rb_release_span(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                      const struct vs_rb_span_t *const span, const enum vs_rb_zeroing zeroing);
+
+/**
+ * The state of a non-destructive scan of the records not consumed yet.
+ */
+struct vs_rb_cursor_t {
+    uint64_t consumer_position;         /*  the consumer position when the scan has started                         */
+    uint64_t position;                  /*  the position after the last scanned record                              */
+};
+
+/**
+ * Start a scan from the consumer position: it can be used only by the consumer.
+ */
+inline static void vs_rb_scan_cursor(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                                     struct vs_rb_cursor_t *const cursor);
+
+/**
+ * Move the cursor to the next committed message, skipping padding records, without consuming it: as
+ * {@code vs_rb_read}, it doesn't find any message in a ring buffer in {@code VS_RB_WRAP_MODE}.
+ *
+ * @returns                     {@code true} if a message has been found, {@code false} if there isn't any other
+ *                              committed message yet
+ */
+inline static bool vs_rb_scan_next(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                                   struct vs_rb_cursor_t *const cursor, uint32_t *const msg_type_id,
+                                   index_t *const msg_content_index, index_t *const msg_content_length);
+
+/**
+ * Consume all the records before {@code position}, ie the {@code position} of the cursor after having scanned the
+ * last message to be consumed: on success the scan can continue with the same cursor, from the new consumer position.
+ *
+ * @param cursor                the cursor of the scan
+ * @param position              a position reached by the scan, between the cursor's consumer position and its position
+ * @returns                     {@code false} if the position isn't a record boundary reached by the scan or the
+ *                              consumer position has changed since the scan has started
+ */
+inline static bool vs_rb_commit_scan(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                     struct vs_rb_cursor_t *const cursor, const uint64_t position);
+
 inline static index_t vs_rb_size(const struct vs_rb_t *const header, const uint8_t *const buffer);
 
 #endif //FRANZ_FLOW_VS_RB_H
@@ -0,0 +1,166 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_VS_RB_FRAGMENT_H
+#define FRANZ_FLOW_VS_RB_FRAGMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "index.h"
+#include "vs_rb.h"
+
+/**
+ * Flags of the msg type id of a fragment: on a ring buffer carrying fragments any message, fragmented or not, must use
+ * a msg type id in {@code [1, VS_RB_FRAGMENT_MSG_TYPE_ID_MASK]}, or the consumer would take it for a fragment.
+ * The not fragmented messages can be published with {@code vs_rb_try_sp_offer_unfragmented},
+ * {@code vs_rb_try_mp_offer_unfragmented} or {@code vs_rb_commit_unfragmented_claim}, that enforce it.
+ */
+#define VS_RB_FRAGMENT_FLAG 0x40000000          /*  the record is a fragment of a bigger message                    */
+#define VS_RB_BEGIN_FRAGMENT_FLAG 0x20000000    /*  first fragment of a message                                     */
+#define VS_RB_END_FRAGMENT_FLAG 0x10000000      /*  last fragment of a message                                      */
+#define VS_RB_FRAGMENT_MSG_TYPE_ID_MASK 0x0FFFFFFF
+
+/**
+ * It precedes the content of each fragment.
+ */
+struct vs_rb_fragment_header_t {
+    uint32_t publisher_id;              /*  the publisher of the fragment, to demultiplex concurrent publishers    */
+    uint32_t fragment_index;            /*  the sequence of the fragment within its message                         */
+    uint64_t message_length;            /*  the length in bytes of the whole message                                */
+};
+
+/**
+ * The state of a message being published as a sequence of fragments: each publisher must use its own.
+ *
+ * The fragments are published one by one, hence a producer can interleave them with other messages and the consumer
+ * doesn't need to wait the whole message to read the messages of the other producers.
+ */
+struct vs_rb_fragmenter_t {
+    const uint8_t *message;             /*  the message being published                                             */
+    uint64_t message_length;
+    uint64_t offset;                    /*  bytes of the message already published                                  */
+    uint32_t fragment_index;            /*  index of the next fragment to be published                              */
+    uint32_t msg_type_id;
+    uint32_t publisher_id;
+    index_t max_fragment_length;        /*  max bytes of the message carried by each fragment                       */
+};
+
+/**
+ * A reusable buffer of the reassembler's pool.
+ */
+struct vs_rb_pool_buffer_t {
+    uint8_t *bytes;
+    uint64_t capacity;                  /*  it grows on demand up to the max message length, and is never shrunk    */
+};
+
+/**
+ * The message being reassembled for a publisher.
+ */
+struct vs_rb_reassembly_t {
+    struct vs_rb_pool_buffer_t *buffer; /*  NULL if there isn't any message in progress                             */
+    uint64_t message_length;
+    uint64_t received;                  /*  bytes of the message already received                                   */
+    uint32_t next_fragment_index;
+    uint32_t msg_type_id;
+};
+
+/**
+ * It reassembles the fragments read from a vs_rb using a pool of reusable buffers, one for each message in progress.
+ *
+ * A fragment that isn't the expected one (out of sequence, too big or without any buffer available in the pool)
+ * drops the message in progress of its publisher.
+ */
+struct vs_rb_reassembler_t {
+    struct vs_rb_reassembly_t *reassemblies;        /*  one for each publisher                                      */
+    uint32_t publishers;
+    struct vs_rb_pool_buffer_t *pool;
+    struct vs_rb_pool_buffer_t **free_buffers;      /*  stack of the buffers not in use                             */
+    uint32_t free_buffers_count;
+    uint32_t pool_buffers;
+    uint64_t max_message_length;
+    uint64_t dropped_messages;
+};
+
+static inline bool vs_rb_is_fragment(const uint32_t msg_type_id);
+
+/**
+ * @param publisher_id          the id of the publisher, unique between all the publishers of the ring buffer
+ * @param max_fragment_length   the max bytes of a message carried by each fragment: 0 to use the biggest fragments
+ *                              that fit whatever is the producer index, ie records of half of the capacity,
+ *                              smaller to not delay the other messages for long
+ * @returns                     {@code false} if the ring buffer can't hold fragments of {@code max_fragment_length}
+ */
+static inline bool new_vs_rb_fragmenter(struct vs_rb_fragmenter_t *const fragmenter,
+                                        const struct vs_rb_t *const header,
+                                        const uint32_t publisher_id, const index_t max_fragment_length);
+
+/**
+ * Start to publish a message: the message content must not change until {@code vs_rb_fragmenter_done}.
+ *
+ * @returns                     {@code false} if the msg type id is not valid or a message is still in progress
+ */
+static inline bool vs_rb_fragmenter_begin(struct vs_rb_fragmenter_t *const fragmenter, const uint32_t msg_type_id,
+                                          const uint8_t *const message, const uint64_t message_length);
+
+static inline bool vs_rb_fragmenter_done(const struct vs_rb_fragmenter_t *const fragmenter);
+
+/**
+ * Try to claim, write and commit the next fragment of the message in progress.
+ *
+ * @returns                     {@code true} if a fragment has been published, {@code false} if the ring buffer is full
+ *                              or there isn't any fragment left
+ */
+static inline bool vs_rb_try_sp_fragment(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                         struct vs_rb_fragmenter_t *const fragmenter);
+
+static inline bool vs_rb_try_mp_fragment(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                         struct vs_rb_fragmenter_t *const fragmenter);
+
+/**
+ * As {@code vs_rb_try_sp_offer}, for a not fragmented message on a ring buffer carrying fragments.
+ *
+ * @returns                     {@code false} if the msg type id isn't in {@code [1, VS_RB_FRAGMENT_MSG_TYPE_ID_MASK]},
+ *                              the ring buffer is full or the message isn't valid
+ */
+static inline bool
+vs_rb_try_sp_offer_unfragmented(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t msg_type_id,
+                                const struct iovec *const segments, const uint32_t segments_count);
+
+static inline bool
+vs_rb_try_mp_offer_unfragmented(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t msg_type_id,
+                                const struct iovec *const segments, const uint32_t segments_count);
+
+/**
+ * As {@code vs_rb_commit_claim}, for a not fragmented message on a ring buffer carrying fragments.
+ *
+ * @returns                     {@code false} if the msg type id isn't in {@code [1, VS_RB_FRAGMENT_MSG_TYPE_ID_MASK]}:
+ *                              the record is left claimed and must be committed with a valid one
+ */
+static inline bool vs_rb_commit_unfragmented_claim(const uint8_t *const buffer, const index_t msg_index,
+                                                   const uint32_t msg_type_id, const index_t msg_content_length);
+
+/**
+ * @param publishers            the publisher ids that can be reassembled are in {@code [0, publishers)}
+ * @param pool_buffers          the max number of messages reassembled at the same time
+ * @param max_message_length    the max length in bytes of a reassembled message
+ */
+static inline bool new_vs_rb_reassembler(struct vs_rb_reassembler_t *const reassembler, const uint32_t publishers,
+                                         const uint32_t pool_buffers, const uint64_t max_message_length);
+
+static inline void vs_rb_reassembler_free(struct vs_rb_reassembler_t *const reassembler);
+
+typedef bool(*const vs_rb_reassembled_consumer)(const uint32_t, const uint8_t *const, const uint64_t, void *const);
+
+/**
+ * To be called by a {@code vs_rb_message_consumer} for each fragment read: when the last fragment of a message is
+ * received the whole message is passed to {@code consumer}, that can't keep any reference to it after returning.
+ *
+ * @returns                     the value returned by {@code consumer} if called, {@code true} otherwise
+ */
+static inline bool vs_rb_reassembler_on_fragment(struct vs_rb_reassembler_t *const reassembler,
+                                                 const uint32_t msg_type_id, const uint8_t *const buffer,
+                                                 const index_t msg_content_index, const index_t msg_content_length,
+                                                 const vs_rb_reassembled_consumer consumer, void *const context);
+
+#endif //FRANZ_FLOW_VS_RB_FRAGMENT_H
@@ -0,0 +1,92 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_VS_RB_LANES_H
+#define FRANZ_FLOW_VS_RB_LANES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "index.h"
+#include "vs_rb.h"
+
+#define VS_RB_MAX_LANES 8
+
+/**
+ * The order in which {@code vs_rb_lanes_read} drains the lanes.
+ */
+enum vs_rb_lanes_policy {
+    VS_RB_LANES_STRICT_PRIORITY,        /*  a lane is read only when all the lanes before it are empty              */
+    VS_RB_LANES_WEIGHTED_ROUND_ROBIN    /*  each lane is read, in turn, up to its weight in messages                */
+};
+
+struct vs_rb_lane_config_t {
+    index_t requested_capacity;         /*  capacity in bytes of the lane's ring buffer, trailer excluded           */
+    uint32_t weight;                    /*  messages read from the lane on each round (round robin only)            */
+    uint32_t batch_limit;               /*  max messages read from the lane before releasing them to its producers  */
+};
+
+struct vs_rb_lane_t {
+    struct vs_rb_t header;
+    uint8_t *buffer;
+    uint32_t weight;
+    uint32_t batch_limit;
+};
+
+/**
+ * Several vs_rb, the lanes, laid one after the other in the same buffer and read by a single consumer: the producers
+ * pick a lane for each message, hence the messages of a lane aren't delayed behind the ones of the other lanes.
+ *
+ * Each lane is a plain vs_rb with its own trailer and the consumer polls it checking only the record header at its
+ * consumer position, without loading the producer position: an idle lane costs a read of lines owned by the consumer.
+ */
+struct vs_rb_lanes_t {
+    struct vs_rb_lane_t lanes[VS_RB_MAX_LANES];
+    uint32_t count;
+    enum vs_rb_lanes_policy policy;
+    uint32_t reading_lane;              /*  lane of the message passed to the consumer, valid only while reading    */
+    uint32_t next_lane;                 /*  round robin: lane to continue to read from                              */
+    uint32_t credits;                   /*  round robin: messages left to be read from next_lane on this round      */
+};
+
+/**
+ * Returns the capacity in bytes of all the lanes, trailers included.
+ */
+inline static index_t vs_rb_lanes_capacity(const struct vs_rb_lane_config_t *const configs, const uint32_t count);
+
+/**
+ * @param buffer                a buffer of {@code vs_rb_lanes_capacity} bytes: zeroed if none of the lanes is in use
+ * @param configs               the configuration of each lane, from the first (the most important one) to the last
+ * @returns                     {@code false} if the configuration of any lane isn't valid
+ */
+inline static bool new_vs_rb_lanes(struct vs_rb_lanes_t *const lanes, uint8_t *const buffer,
+                                   const struct vs_rb_lane_config_t *const configs, const uint32_t count,
+                                   const enum vs_rb_lanes_policy policy);
+
+/**
+ * The ring buffer of a lane, to be used with any of the vs_rb claims or offers.
+ */
+inline static const struct vs_rb_t *vs_rb_lanes_header(const struct vs_rb_lanes_t *const lanes, const uint32_t lane);
+
+inline static uint8_t *vs_rb_lanes_buffer(const struct vs_rb_lanes_t *const lanes, const uint32_t lane);
+
+inline static bool
+vs_rb_lanes_try_sp_offer(const struct vs_rb_lanes_t *const lanes, const uint32_t lane, const uint32_t msg_type_id,
+                         const struct iovec *const segments, const uint32_t segments_count);
+
+inline static bool
+vs_rb_lanes_try_mp_offer(const struct vs_rb_lanes_t *const lanes, const uint32_t lane, const uint32_t msg_type_id,
+                         const struct iovec *const segments, const uint32_t segments_count);
+
+/**
+ * Read up to {@code count} messages from the lanes, in the order defined by the policy: each lane is read as with
+ * {@code vs_rb_read}, in batches of at most its {@code batch_limit} messages.
+ * The consumer can find the lane of the message in {@code lanes->reading_lane} and stops the whole read returning
+ * {@code false}.
+ *
+ * @returns                     the number of messages read
+ */
+inline static uint32_t vs_rb_lanes_read(struct vs_rb_lanes_t *const lanes, const vs_rb_message_consumer consumer,
+                                        const uint32_t count, void *const context);
+
+#endif //FRANZ_FLOW_VS_RB_LANES_H
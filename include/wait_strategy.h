@@ -0,0 +1,79 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_WAIT_STRATEGY_H
+#define FRANZ_FLOW_WAIT_STRATEGY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum wait_strategy_type {
+    BUSY_SPIN_WAIT,                     /*  spin with a pause instruction                                           */
+    BACKOFF_WAIT,                       /*  spin, then yield, then sleep for exponentially longer periods           */
+    YIELD_WAIT,                         /*  yield the cpu on each idle                                              */
+    PARK_WAIT                           /*  spin, then yield, then sleep on a park word until unparked              */
+};
+
+/**
+ * Called by a parking waiter after having announced it is parked: if it returns {@code true} the waiter won't sleep.
+ */
+typedef bool(*wait_condition)(void *const);
+
+/**
+ * It holds the configuration of a wait strategy, to be used by producers/consumers of any queue while idle.
+ *
+ * The park word of {@code PARK_WAIT} is a 4 bytes word in the queue trailer (ie {@code vs_rb_consumer_park_word}):
+ * the waiter sleeps on it only after having announced it and the producers need to call {@code wait_strategy_unpark}
+ * after each commit to wake it up: they perform a syscall only when any waiter has announced to be parked.
+ * The park word counts the parked waiters, hence it can be shared by several of them (ie the workers of an executor).
+ */
+struct wait_strategy_t {
+    enum wait_strategy_type type;
+    uint32_t max_spins;                 /*  idles spent spinning before yielding                                    */
+    uint32_t max_yields;                /*  idles spent yielding before sleeping                                    */
+    uint64_t max_park_nanos;            /*  max duration of a single sleep                                          */
+    _Atomic uint32_t *park_word;        /*  PARK_WAIT only: the word to sleep on                                    */
+    wait_condition is_ready;            /*  PARK_WAIT only: checked after announcing the park                       */
+    void *context;                      /*  PARK_WAIT only: the is_ready argument                                   */
+};
+
+static inline void new_busy_spin_wait_strategy(struct wait_strategy_t *const strategy);
+
+static inline void new_yield_wait_strategy(struct wait_strategy_t *const strategy);
+
+/**
+ * @param max_park_nanos        the max duration of a single sleep: must be greater than 0, or each idle after the
+ *                              spins and the yields would be a syscall that returns immediately
+ * @returns                     {@code false} if {@code max_park_nanos} is 0
+ */
+static inline bool new_backoff_wait_strategy(struct wait_strategy_t *const strategy,
+                                             const uint32_t max_spins,
+                                             const uint32_t max_yields,
+                                             const uint64_t max_park_nanos);
+
+/**
+ * As {@code new_backoff_wait_strategy}, but sleeping on {@code park_word} until unparked or {@code max_park_nanos}.
+ */
+static inline bool new_park_wait_strategy(struct wait_strategy_t *const strategy,
+                                          const uint32_t max_spins,
+                                          const uint32_t max_yields,
+                                          const uint64_t max_park_nanos,
+                                          _Atomic uint32_t *const park_word,
+                                          const wait_condition is_ready,
+                                          void *const context);
+
+/**
+ * Wait according to the strategy and the number of consecutive idles.
+ *
+ * @param idle_count            the number of consecutive idles: must be reset to 0 after any progress
+ * @returns                     the next idle_count value
+ */
+static inline uint32_t wait_strategy_idle(const struct wait_strategy_t *const strategy, const uint32_t idle_count);
+
+/**
+ * Wake up all the waiters parked on the park word, to be called after having committed any message.
+ */
+static inline void wait_strategy_unpark(_Atomic uint32_t *const park_word);
+
+#endif //FRANZ_FLOW_WAIT_STRATEGY_H
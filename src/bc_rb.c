@@ -0,0 +1,242 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_BC_RB_C
+#define FRANZ_FLOW_BC_RB_C
+
+#include <stdatomic.h>
+#include <string.h>
+#include "bc_rb.h"
+#include "vs_rb.c"
+
+/**
+ * Offset within the trailer for where the producer intent value is stored: it is ahead of the producer position
+ * while a record is being written and is used by the subscribers of an overrun ring buffer to detect the loss.
+ */
+static const index_t BC_RB_PRODUCER_INTENT_POSITION_OFFSET = CACHE_LINE_LENGTH * 2;
+/**
+ * Offset within the trailer for where the producer value is stored.
+ */
+static const index_t BC_RB_PRODUCER_POSITION_OFFSET = CACHE_LINE_LENGTH * 4;
+/**
+ * Offset within the trailer for where the last known position of the slowest subscriber is stored.
+ */
+static const index_t BC_RB_SUBSCRIBERS_CACHE_POSITION_OFFSET = CACHE_LINE_LENGTH * 6;
+/**
+ * Offset within the trailer for where the consumer park word is stored.
+ */
+static const index_t BC_RB_CONSUMER_PARK_OFFSET = CACHE_LINE_LENGTH * 8;
+/**
+ * Offset within the trailer for where the subscriber positions are stored.
+ */
+static const index_t BC_RB_SUBSCRIBER_POSITIONS_OFFSET = CACHE_LINE_LENGTH * 10;
+/**
+ * Each subscriber position uses its own cache lines.
+ */
+static const index_t BC_RB_SUBSCRIBER_POSITION_LENGTH = CACHE_LINE_LENGTH * 2;
+
+inline static index_t bc_rb_trailer_length(const index_t subscribers) {
+    return BC_RB_SUBSCRIBER_POSITIONS_OFFSET + (subscribers * BC_RB_SUBSCRIBER_POSITION_LENGTH);
+}
+
+inline static index_t bc_rb_capacity(const index_t requested_capacity, const index_t subscribers) {
+    return next_pow_2(requested_capacity) + bc_rb_trailer_length(subscribers);
+}
+
+inline static bool new_bc_rb(struct bc_rb_t *const header, const index_t length, const index_t subscribers,
+                             const enum bc_rb_mode mode) {
+    if (subscribers <= 0) {
+        return false;
+    }
+    const index_t capacity = length - bc_rb_trailer_length(subscribers);
+    if (!is_pow_2(capacity)) {
+        return false;
+    }
+    header->capacity = capacity;
+    header->max_msg_length = capacity - RECORD_HEADER_LENGTH;
+    header->producer_intent_position_index = capacity + BC_RB_PRODUCER_INTENT_POSITION_OFFSET;
+    header->producer_position_index = capacity + BC_RB_PRODUCER_POSITION_OFFSET;
+    header->subscribers_cache_position_index = capacity + BC_RB_SUBSCRIBERS_CACHE_POSITION_OFFSET;
+    header->consumer_park_index = capacity + BC_RB_CONSUMER_PARK_OFFSET;
+    header->subscriber_positions_index = capacity + BC_RB_SUBSCRIBER_POSITIONS_OFFSET;
+    header->subscribers = subscribers;
+    header->mode = mode;
+    return true;
+}
+
+inline static _Atomic uint64_t *bc_rb_position(const uint8_t *const buffer, const index_t index) {
+    return (_Atomic uint64_t *) (buffer + index);
+}
+
+inline static _Atomic uint64_t *
+bc_rb_subscriber_position(const struct bc_rb_t *const header, const uint8_t *const buffer, const index_t subscriber) {
+    return bc_rb_position(buffer,
+                          header->subscriber_positions_index + (subscriber * BC_RB_SUBSCRIBER_POSITION_LENGTH));
+}
+
+inline static uint64_t bc_rb_load_producer_position(const struct bc_rb_t *const header, const uint8_t *const buffer) {
+    return atomic_load_explicit(bc_rb_position(buffer, header->producer_position_index), memory_order_acquire);
+}
+
+inline static uint64_t bc_rb_load_subscriber_position(const struct bc_rb_t *const header, const uint8_t *const buffer,
+                                                      const index_t subscriber) {
+    return atomic_load_explicit(bc_rb_subscriber_position(header, buffer, subscriber), memory_order_acquire);
+}
+
+inline static _Atomic uint32_t *bc_rb_consumer_park_word(const struct bc_rb_t *const header, uint8_t *const buffer) {
+    return (_Atomic uint32_t *) (buffer + header->consumer_park_index);
+}
+
+inline static uint64_t
+load_acquire_min_subscriber_position(const struct bc_rb_t *const header, const uint8_t *const buffer) {
+    uint64_t min_subscriber_position = UINT64_MAX;
+    for (index_t i = 0; i < header->subscribers; i++) {
+        const uint64_t subscriber_position = bc_rb_load_subscriber_position(header, buffer, i);
+        if (subscriber_position < min_subscriber_position) {
+            min_subscriber_position = subscriber_position;
+        }
+    }
+    return min_subscriber_position;
+}
+
+inline static bool bc_rb_try_claim(const struct bc_rb_t *const header, uint8_t *const buffer,
+                                   const index_t required_capacity,
+                                   uint64_t *const claimed_position, index_t *const claimed_index) {
+    if (required_capacity > header->max_msg_length) {
+        return false;
+    }
+    const index_t capacity = header->capacity;
+    const index_t mask = capacity - 1;
+    //single producer: it is the only one to change it
+    const uint64_t producer_position = atomic_load_explicit(bc_rb_position(buffer, header->producer_position_index),
+                                                            memory_order_relaxed);
+    const index_t required_msg_capacity = vs_rb_required_record_capacity(required_capacity);
+    const index_t producer_index = producer_position & mask;
+    const index_t bytes_until_end_of_buffer = capacity - producer_index;
+    const index_t padding = required_msg_capacity > bytes_until_end_of_buffer ? bytes_until_end_of_buffer : 0;
+    const uint64_t new_producer_position = producer_position + padding + required_msg_capacity;
+    if (header->mode == BC_RB_GATED) {
+        uint64_t *const subscribers_cache_position_address =
+                (uint64_t *) (buffer + header->subscribers_cache_position_index);
+        //only when the cached position is not enough it checks all the subscribers
+        if ((new_producer_position - *subscribers_cache_position_address) > capacity) {
+            const uint64_t min_subscriber_position = load_acquire_min_subscriber_position(header, buffer);
+            if ((new_producer_position - min_subscriber_position) > capacity) {
+                return false;
+            }
+            *subscribers_cache_position_address = min_subscriber_position;
+        }
+    } else {
+        //the subscribers must know that the bytes until the new producer position could be overwritten
+        atomic_store_explicit(bc_rb_position(buffer, header->producer_intent_position_index), new_producer_position,
+                              memory_order_relaxed);
+        //StoreStore: the intent must be visible before any write on the claimed bytes
+        atomic_thread_fence(memory_order_release);
+    }
+    if (padding != 0) {
+        //it will be published together with the claimed record by the producer position release
+        *((uint64_t *) (buffer + producer_index)) = make_header(RECORD_PADDING_MSG_TYPE_ID, padding);
+    }
+    const uint64_t msg_position = producer_position + padding;
+    *claimed_position = msg_position;
+    *claimed_index = msg_position & mask;
+    return true;
+}
+
+inline static bool bc_rb_commit_claim(const struct bc_rb_t *const header, uint8_t *const buffer,
+                                      const uint64_t claimed_position, const uint32_t msg_type_id,
+                                      const index_t msg_content_length) {
+    if (!check_msg_type_id(msg_type_id)) {
+        return false;
+    }
+    const index_t msg_length = msg_content_length + RECORD_HEADER_LENGTH;
+    const index_t msg_index = claimed_position & (header->capacity - 1);
+    *((uint64_t *) (buffer + msg_index)) = make_header(msg_type_id, msg_length);
+    //the subscribers don't rely on the record header but on the producer position to know what could be read
+    atomic_store_explicit(bc_rb_position(buffer, header->producer_position_index),
+                          claimed_position + align(msg_length, RECORD_ALIGNMENT), memory_order_release);
+    return true;
+}
+
+inline static uint32_t bc_rb_read(const struct bc_rb_t *const header, uint8_t *const buffer,
+                                  const index_t subscriber,
+                                  const vs_rb_message_consumer consumer,
+                                  const uint32_t count, void *const context) {
+    _Atomic uint64_t *const subscriber_position_address = bc_rb_subscriber_position(header, buffer, subscriber);
+    const uint64_t subscriber_position = atomic_load_explicit(subscriber_position_address, memory_order_relaxed);
+    const uint64_t producer_position = bc_rb_load_producer_position(header, buffer);
+    const index_t mask = header->capacity - 1;
+    uint64_t position = subscriber_position;
+    uint32_t msg_read = 0;
+    bool stop = false;
+    while (!stop && (position < producer_position) && (msg_read < count)) {
+        const index_t msg_index = position & mask;
+        const uint64_t msg_header = *((const uint64_t *) (buffer + msg_index));
+        const index_t msg_length = record_length(msg_header);
+        position += align(msg_length, RECORD_ALIGNMENT);
+        const uint32_t msg_type_id = message_type_id(msg_header);
+        if (msg_type_id != RECORD_PADDING_MSG_TYPE_ID) {
+            msg_read++;
+            stop = !consumer(msg_type_id, buffer, msg_index + RECORD_HEADER_LENGTH, msg_length - RECORD_HEADER_LENGTH,
+                             context);
+        }
+    }
+    if (position != subscriber_position) {
+        //the producer of a gated ring buffer could reuse the read bytes from now on
+        atomic_store_explicit(subscriber_position_address, position, memory_order_release);
+    }
+    return msg_read;
+}
+
+inline static uint32_t bc_rb_read_overrun(const struct bc_rb_t *const header, uint8_t *const buffer,
+                                          const index_t subscriber,
+                                          const vs_rb_message_consumer consumer,
+                                          const uint32_t count, void *const context,
+                                          uint8_t *const scratch, uint64_t *const lost_bytes) {
+    _Atomic uint64_t *const subscriber_position_address = bc_rb_subscriber_position(header, buffer, subscriber);
+    const _Atomic uint64_t *const producer_intent_position_address =
+            bc_rb_position(buffer, header->producer_intent_position_index);
+    const uint64_t subscriber_position = atomic_load_explicit(subscriber_position_address, memory_order_relaxed);
+    const uint64_t producer_position = bc_rb_load_producer_position(header, buffer);
+    const index_t capacity = header->capacity;
+    const index_t mask = capacity - 1;
+    uint64_t position = subscriber_position;
+    uint32_t msg_read = 0;
+    bool stop = false;
+    while (!stop && (position < producer_position) && (msg_read < count)) {
+        const index_t msg_index = position & mask;
+        //the record could be overwritten while reading it: nothing read is trusted before validating it
+        const uint64_t msg_header = *((const volatile uint64_t *) (buffer + msg_index));
+        const index_t msg_length = record_length(msg_header);
+        const uint32_t msg_type_id = message_type_id(msg_header);
+        const bool valid_length = msg_length >= RECORD_HEADER_LENGTH && msg_length <= (capacity - msg_index);
+        const bool is_padding = msg_type_id == RECORD_PADDING_MSG_TYPE_ID;
+        const index_t msg_content_length = msg_length - RECORD_HEADER_LENGTH;
+        if (valid_length && !is_padding) {
+            memcpy(scratch, buffer + msg_index + RECORD_HEADER_LENGTH, msg_content_length);
+        }
+        //LoadLoad: the intent must be read after the record
+        atomic_thread_fence(memory_order_acquire);
+        const uint64_t producer_intent_position = atomic_load_explicit(producer_intent_position_address,
+                                                                       memory_order_relaxed);
+        if (!valid_length || (producer_intent_position - position) > capacity) {
+            //lapped: skip to the last committed record boundary
+            const uint64_t last_producer_position = bc_rb_load_producer_position(header, buffer);
+            *lost_bytes += last_producer_position - position;
+            position = last_producer_position;
+            break;
+        }
+        position += align(msg_length, RECORD_ALIGNMENT);
+        if (!is_padding) {
+            msg_read++;
+            stop = !consumer(msg_type_id, scratch, 0, msg_content_length, context);
+        }
+    }
+    if (position != subscriber_position) {
+        atomic_store_explicit(subscriber_position_address, position, memory_order_release);
+    }
+    return msg_read;
+}
+
+#endif //FRANZ_FLOW_BC_RB_C
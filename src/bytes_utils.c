@@ -2,8 +2,15 @@
 // Created by forked_franz on 04/02/17.
 //
 
+#ifndef FRANZ_FLOW_BYTES_UTILS_C
+#define FRANZ_FLOW_BYTES_UTILS_C
+
 #include <stdbool.h>
+#include <string.h>
 #include "index.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define CACHE_LINE_LENGTH 64
 
@@ -26,3 +33,59 @@ inline static index_t next_pow_2(const index_t value) {
     v++;
     return v;
 }
+
+inline static void zero_bytes(uint8_t *const bytes, const index_t length) {
+    memset(bytes, 0, length);
+}
+
+inline static void zero_bytes_non_temporal(uint8_t *const bytes, const index_t length) {
+#if defined(__SSE2__)
+    uint8_t *const end = bytes + length;
+    uint8_t *aligned_bytes = (uint8_t *) (((uintptr_t) bytes + 15) & ~((uintptr_t) 15));
+    if (aligned_bytes > end) {
+        aligned_bytes = end;
+    }
+    memset(bytes, 0, aligned_bytes - bytes);
+    const __m128i zero = _mm_setzero_si128();
+    uint8_t *current = aligned_bytes;
+    for (; (current + 16) <= end; current += 16) {
+        _mm_stream_si128((__m128i *) current, zero);
+    }
+    memset(current, 0, end - current);
+    //the streaming stores are weakly ordered: they must be globally visible before any following release store
+    _mm_sfence();
+#else
+    memset(bytes, 0, length);
+#endif
+}
+
+/**
+ * Above it the copies are performed with non temporal stores: a copy that big would evict from the caches most of
+ * the data of the caller without any benefit for the reader, that is going to miss the caches anyway.
+ */
+#define NON_TEMPORAL_COPY_THRESHOLD (64 * 1024)
+
+inline static void copy_bytes_non_temporal(uint8_t *const destination, const uint8_t *const source,
+                                           const index_t length) {
+#if defined(__SSE2__)
+    uint8_t *const end = destination + length;
+    uint8_t *aligned_destination = (uint8_t *) (((uintptr_t) destination + 15) & ~((uintptr_t) 15));
+    if (aligned_destination > end) {
+        aligned_destination = end;
+    }
+    const index_t unaligned_length = aligned_destination - destination;
+    memcpy(destination, source, unaligned_length);
+    const uint8_t *current_source = source + unaligned_length;
+    uint8_t *current = aligned_destination;
+    for (; (current + 16) <= end; current += 16, current_source += 16) {
+        _mm_stream_si128((__m128i *) current, _mm_loadu_si128((const __m128i *) current_source));
+    }
+    memcpy(current, current_source, end - current);
+    //the streaming stores are weakly ordered: they must be globally visible before any following release store
+    _mm_sfence();
+#else
+    memcpy(destination, source, length);
+#endif
+}
+
+#endif //FRANZ_FLOW_BYTES_UTILS_C
@@ -0,0 +1,153 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_FS_CONFLATING_RB_C
+#define FRANZ_FLOW_FS_CONFLATING_RB_C
+
+#include <stdatomic.h>
+#include <string.h>
+#include "fs_conflating_rb.h"
+#include "fs_rb.c"
+
+#define CONFLATING_KEY_SIZE 4
+
+/**
+ * The message states in addition to the fs_rb ones: MESSAGE_STATE_BUSY marks a committed message.
+ */
+static const uint32_t MESSAGE_STATE_WRITING = 2;
+static const uint32_t MESSAGE_STATE_CONSUMING = 3;
+static const index_t CONFLATING_PRODUCER_POSITION_OFFSET = CACHE_LINE_LENGTH * 2;
+static const index_t CONFLATING_CONSUMER_POSITION_OFFSET = CACHE_LINE_LENGTH * 4;
+static const index_t CONFLATING_CONSUMER_PARK_OFFSET = CACHE_LINE_LENGTH * 6;
+static const index_t CONFLATING_COUNTERS_OFFSET = CACHE_LINE_LENGTH * 8;
+static const index_t CONFLATING_PENDING_POSITIONS_OFFSET = (CACHE_LINE_LENGTH * 8) + RB_COUNTERS_LENGTH;
+
+static inline index_t conflating_aligned_message_size(const uint32_t message_size) {
+    //the message is 8 bytes aligned after the message state and the key
+    return align(MESSAGE_STATE_SIZE + CONFLATING_KEY_SIZE + message_size, sizeof(uint64_t));
+}
+
+static inline index_t
+fs_conflating_rb_capacity(const index_t requested_capacity, const uint32_t message_size, const uint32_t keys) {
+    const index_t capacity_bytes = next_pow_2(requested_capacity) * conflating_aligned_message_size(message_size);
+    const index_t pending_positions_bytes = align(keys * sizeof(uint64_t), CACHE_LINE_LENGTH * 2);
+    return capacity_bytes + CONFLATING_PENDING_POSITIONS_OFFSET + pending_positions_bytes;
+}
+
+static inline bool
+new_fs_conflating_rb(uint8_t *const buffer, struct fs_conflating_rb_t *const header,
+                     const index_t requested_capacity, const uint32_t message_size, const uint32_t keys) {
+    if (keys == 0) {
+        return false;
+    }
+    const index_t capacity = next_pow_2(requested_capacity);
+    const index_t aligned_message_size = conflating_aligned_message_size(message_size);
+    uint8_t *const trailer = buffer + (capacity * aligned_message_size);
+    header->capacity = capacity;
+    header->mask = capacity - 1;
+    header->aligned_message_size = aligned_message_size;
+    header->message_size = message_size;
+    header->keys = keys;
+    header->producer_position = trailer + CONFLATING_PRODUCER_POSITION_OFFSET;
+    header->consumer_position = trailer + CONFLATING_CONSUMER_POSITION_OFFSET;
+    header->consumer_park = trailer + CONFLATING_CONSUMER_PARK_OFFSET;
+    header->counters = trailer + CONFLATING_COUNTERS_OFFSET;
+    header->pending_positions = trailer + CONFLATING_PENDING_POSITIONS_OFFSET;
+    return true;
+}
+
+static inline _Atomic uint32_t *
+conflating_message_state(uint8_t *const buffer, const struct fs_conflating_rb_t *const header,
+                         const uint64_t position) {
+    return (_Atomic uint32_t *) (buffer + ((position & header->mask) * header->aligned_message_size));
+}
+
+static inline bool try_overwrite_pending(uint8_t *const buffer, const struct fs_conflating_rb_t *const header,
+                                         const uint64_t pending_position, const uint8_t *const message) {
+    _Atomic uint32_t *const message_state = conflating_message_state(buffer, header, pending_position);
+    uint32_t expected_state = MESSAGE_STATE_BUSY;
+    //the consumer can't claim it while is being written: the message stores can't be moved before it
+    if (!atomic_compare_exchange_strong_explicit(message_state, &expected_state, MESSAGE_STATE_WRITING,
+                                                 memory_order_acquire, memory_order_relaxed)) {
+        //the consumer has claimed or consumed it
+        return false;
+    }
+    memcpy(((uint8_t *) message_state) + MESSAGE_STATE_SIZE + CONFLATING_KEY_SIZE, message, header->message_size);
+    atomic_store_explicit(message_state, MESSAGE_STATE_BUSY, memory_order_release);
+    return true;
+}
+
+static inline bool fs_conflating_rb_offer(uint8_t *const buffer, const struct fs_conflating_rb_t *const header,
+                                          const uint32_t key, const uint8_t *const message) {
+    if (key >= header->keys) {
+        return false;
+    }
+    _Atomic uint64_t *const producer_position_address = (_Atomic uint64_t *) header->producer_position;
+    const uint64_t producer_position = atomic_load_explicit(producer_position_address, memory_order_relaxed);
+    uint64_t *const pending_position_address = ((uint64_t *) header->pending_positions) + key;
+    const uint64_t pending_position = *pending_position_address;
+    //0 means no message has ever been offered for the key: a slot more than a lap behind could be reused by another key
+    if (pending_position != 0 && (producer_position - (pending_position - 1)) <= (uint64_t) header->capacity &&
+        try_overwrite_pending(buffer, header, pending_position - 1, message)) {
+        RB_COUNTER_INCREMENT(header->counters, RB_CONFLATED_UPDATES);
+        return true;
+    }
+    _Atomic uint32_t *const message_state = conflating_message_state(buffer, header, producer_position);
+    if (atomic_load_explicit(message_state, memory_order_acquire) != MESSAGE_STATE_FREE) {
+        RB_COUNTER_INCREMENT(header->counters, RB_FULL_CLAIMS);
+        return false;
+    }
+    uint8_t *const key_address = ((uint8_t *) message_state) + MESSAGE_STATE_SIZE;
+    memcpy(key_address, &key, CONFLATING_KEY_SIZE);
+    memcpy(key_address + CONFLATING_KEY_SIZE, message, header->message_size);
+    atomic_store_explicit(message_state, MESSAGE_STATE_BUSY, memory_order_release);
+    *pending_position_address = producer_position + 1;
+    atomic_store_explicit(producer_position_address, producer_position + 1, memory_order_release);
+    RB_COUNTER_INCREMENT(header->counters, RB_CLAIMS);
+    return true;
+}
+
+static inline uint32_t fs_conflating_rb_read(uint8_t *const buffer, const struct fs_conflating_rb_t *const header,
+                                             const fs_conflating_rb_message_consumer consumer,
+                                             const uint32_t count, void *const context) {
+    _Atomic uint64_t *const consumer_position_address = (_Atomic uint64_t *) header->consumer_position;
+    const uint64_t consumer_position = atomic_load_explicit(consumer_position_address, memory_order_relaxed);
+    uint32_t msg_read = 0;
+    bool stop = false;
+    while (!stop && msg_read < count) {
+        const uint64_t message_position = consumer_position + msg_read;
+        _Atomic uint32_t *const message_state = conflating_message_state(buffer, header, message_position);
+        uint32_t expected_state = MESSAGE_STATE_BUSY;
+        //a message being overwritten (or not committed yet) will be read on the next read
+        if (!atomic_compare_exchange_strong_explicit(message_state, &expected_state, MESSAGE_STATE_CONSUMING,
+                                                     memory_order_acquire, memory_order_relaxed)) {
+            break;
+        }
+        const uint8_t *const key_address = ((uint8_t *) message_state) + MESSAGE_STATE_SIZE;
+        uint32_t key;
+        memcpy(&key, key_address, CONFLATING_KEY_SIZE);
+        stop = !consumer(key, key_address + CONFLATING_KEY_SIZE, context);
+        atomic_store_explicit(message_state, MESSAGE_STATE_FREE, memory_order_release);
+        msg_read++;
+    }
+    if (msg_read != 0) {
+        atomic_store_explicit(consumer_position_address, consumer_position + msg_read, memory_order_release);
+    }
+    RB_COUNTER_INCREMENT(header->counters, msg_read != 0 ? RB_READS : RB_EMPTY_READS);
+    return msg_read;
+}
+
+static inline index_t fs_conflating_rb_size(const struct fs_conflating_rb_t *const header) {
+    return fs_rb_positions_size(header->producer_position, header->consumer_position);
+}
+
+static inline _Atomic uint32_t *fs_conflating_rb_consumer_park_word(const struct fs_conflating_rb_t *const header) {
+    return (_Atomic uint32_t *) header->consumer_park;
+}
+
+static inline const uint8_t *fs_conflating_rb_counters(const struct fs_conflating_rb_t *const header) {
+    return header->counters;
+}
+
+#endif //FRANZ_FLOW_FS_CONFLATING_RB_C
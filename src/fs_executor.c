@@ -0,0 +1,287 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_FS_EXECUTOR_C
+#define FRANZ_FLOW_FS_EXECUTOR_C
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "fs_executor.h"
+#include "fs_mpmc_rb.c"
+#include "rb_alloc.c"
+#include "wait_strategy.c"
+
+#define FS_EXECUTOR_TASK_SIZE 16
+//max tasks moved from the injection queue to the deque of a worker at once
+#define FS_EXECUTOR_INJECTION_BATCH 16
+
+static const index_t DEQUE_TOP_OFFSET = CACHE_LINE_LENGTH * 2;
+static const index_t DEQUE_BOTTOM_OFFSET = CACHE_LINE_LENGTH * 4;
+static const index_t DEQUE_TRAILER_LENGTH = CACHE_LINE_LENGTH * 6;
+
+static inline index_t deque_length(const index_t capacity) {
+    return (capacity * FS_EXECUTOR_TASK_SIZE) + DEQUE_TRAILER_LENGTH;
+}
+
+static inline void new_deque(struct fs_executor_deque_t *const deque, uint8_t *const buffer, const index_t capacity) {
+    uint8_t *const trailer = buffer + (capacity * FS_EXECUTOR_TASK_SIZE);
+    deque->slots = buffer;
+    deque->top = trailer + DEQUE_TOP_OFFSET;
+    deque->bottom = trailer + DEQUE_BOTTOM_OFFSET;
+    deque->capacity = capacity;
+    deque->mask = capacity - 1;
+}
+
+static inline _Atomic uint64_t *deque_slot(const struct fs_executor_deque_t *const deque, const int64_t position) {
+    return (_Atomic uint64_t *) (deque->slots + ((position & deque->mask) * FS_EXECUTOR_TASK_SIZE));
+}
+
+/**
+ * The slots are written and read as atomic words: a thief can read a slot while its owner overwrites it, but then
+ * it fails to steal it.
+ */
+static inline void store_task(_Atomic uint64_t *const slot, const struct fs_executor_task_t *const task) {
+    atomic_store_explicit(slot, (uint64_t) (uintptr_t) task->run, memory_order_relaxed);
+    atomic_store_explicit(slot + 1, (uint64_t) (uintptr_t) task->argument, memory_order_relaxed);
+}
+
+static inline void load_task(const _Atomic uint64_t *const slot, struct fs_executor_task_t *const task) {
+    task->run = (fs_executor_task_function) (uintptr_t) atomic_load_explicit(slot, memory_order_relaxed);
+    task->argument = (void *) (uintptr_t) atomic_load_explicit(slot + 1, memory_order_relaxed);
+}
+
+static inline index_t deque_size(const struct fs_executor_deque_t *const deque) {
+    const int64_t bottom = atomic_load_explicit((_Atomic int64_t *) deque->bottom, memory_order_relaxed);
+    const int64_t top = atomic_load_explicit((_Atomic int64_t *) deque->top, memory_order_relaxed);
+    return bottom > top ? (index_t) (bottom - top) : 0;
+}
+
+/**
+ * The Chase-Lev deque operations, with the C11 memory orders of "Correct and Efficient Work-Stealing for Weak
+ * Memory Models" (Lê et al.): only the owner can push and take.
+ */
+static inline bool deque_push(const struct fs_executor_deque_t *const deque,
+                              const struct fs_executor_task_t *const task) {
+    _Atomic int64_t *const bottom_address = (_Atomic int64_t *) deque->bottom;
+    const int64_t bottom = atomic_load_explicit(bottom_address, memory_order_relaxed);
+    const int64_t top = atomic_load_explicit((_Atomic int64_t *) deque->top, memory_order_acquire);
+    if (bottom - top >= deque->capacity) {
+        return false;
+    }
+    store_task(deque_slot(deque, bottom), task);
+    atomic_store_explicit(bottom_address, bottom + 1, memory_order_release);
+    return true;
+}
+
+static inline bool deque_take(const struct fs_executor_deque_t *const deque, struct fs_executor_task_t *const task) {
+    _Atomic int64_t *const bottom_address = (_Atomic int64_t *) deque->bottom;
+    _Atomic int64_t *const top_address = (_Atomic int64_t *) deque->top;
+    const int64_t bottom = atomic_load_explicit(bottom_address, memory_order_relaxed) - 1;
+    atomic_store_explicit(bottom_address, bottom, memory_order_relaxed);
+    //StoreLoad: the thieves must see the reserved bottom before the owner reads the top
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(top_address, memory_order_relaxed);
+    if (top > bottom) {
+        //empty
+        atomic_store_explicit(bottom_address, bottom + 1, memory_order_relaxed);
+        return false;
+    }
+    load_task(deque_slot(deque, bottom), task);
+    if (top < bottom) {
+        return true;
+    }
+    //the last task: it races with the thieves
+    const bool taken = atomic_compare_exchange_strong_explicit(top_address, &top, top + 1, memory_order_seq_cst,
+                                                               memory_order_relaxed);
+    atomic_store_explicit(bottom_address, bottom + 1, memory_order_relaxed);
+    return taken;
+}
+
+static inline bool deque_steal(const struct fs_executor_deque_t *const deque, struct fs_executor_task_t *const task) {
+    _Atomic int64_t *const top_address = (_Atomic int64_t *) deque->top;
+    int64_t top = atomic_load_explicit(top_address, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    const int64_t bottom = atomic_load_explicit((_Atomic int64_t *) deque->bottom, memory_order_acquire);
+    if (top >= bottom) {
+        return false;
+    }
+    load_task(deque_slot(deque, top), task);
+    //a failed steal doesn't retry: the thief moves on to the next victim
+    return atomic_compare_exchange_strong_explicit(top_address, &top, top + 1, memory_order_seq_cst,
+                                                   memory_order_relaxed);
+}
+
+static inline _Atomic uint32_t *executor_park_word(const struct fs_executor_t *const executor) {
+    return (_Atomic uint32_t *) executor->injection.consumer_park;
+}
+
+static inline bool executor_has_tasks(const struct fs_executor_t *const executor) {
+    if (fs_rb_size(&executor->injection) != 0) {
+        return true;
+    }
+    for (uint32_t i = 0; i < executor->worker_count; i++) {
+        if (deque_size(&executor->workers[i].deque) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline bool executor_is_ready(void *const context) {
+    const struct fs_executor_t *const executor = (const struct fs_executor_t *) context;
+    return !atomic_load_explicit(&executor->running, memory_order_relaxed) || executor_has_tasks(executor);
+}
+
+static inline bool new_fs_executor(struct fs_executor_t *const executor, const uint32_t workers,
+                                   const index_t deque_capacity, const index_t injection_capacity,
+                                   const struct wait_strategy_t *const wait_strategy) {
+    if (workers == 0 || workers > FS_EXECUTOR_MAX_WORKERS || deque_capacity <= 0 || injection_capacity <= 0) {
+        return false;
+    }
+    const index_t deque_capacity_pow_2 = next_pow_2(deque_capacity);
+    const index_t injection_length = fs_rb_capacity(injection_capacity, FS_EXECUTOR_TASK_SIZE);
+    const index_t length = injection_length + (workers * deque_length(deque_capacity_pow_2));
+    if (!rb_alloc(length, RB_ALLOC_ANY_NUMA_NODE, 0, &executor->memory)) {
+        return false;
+    }
+    executor->injection_buffer = executor->memory.buffer;
+    if (!new_fs_mpmc_rb(executor->injection_buffer, &executor->injection, injection_capacity,
+                        FS_EXECUTOR_TASK_SIZE)) {
+        rb_free(&executor->memory);
+        return false;
+    }
+    uint8_t *deque_buffer = executor->memory.buffer + injection_length;
+    for (uint32_t i = 0; i < workers; i++) {
+        struct fs_executor_worker_t *const worker = &executor->workers[i];
+        worker->executor = executor;
+        worker->index = i;
+        //any not zero seed works: they just need to differ between the workers
+        worker->victim_seed = 0x9E3779B97F4A7C15UL * (i + 1);
+        new_deque(&worker->deque, deque_buffer, deque_capacity_pow_2);
+        deque_buffer += deque_length(deque_capacity_pow_2);
+        worker->wait_strategy = *wait_strategy;
+        if (wait_strategy->type == PARK_WAIT) {
+            worker->wait_strategy.park_word = executor_park_word(executor);
+            worker->wait_strategy.is_ready = executor_is_ready;
+            worker->wait_strategy.context = executor;
+        }
+    }
+    executor->worker_count = workers;
+    executor->started_workers = 0;
+    atomic_init(&executor->running, false);
+    return true;
+}
+
+static inline bool fs_executor_submit(struct fs_executor_t *const executor, const fs_executor_task_function run,
+                                      void *const argument) {
+    uint8_t *claimed_message;
+    if (!try_fs_mpmc_rb_claim(executor->injection_buffer, &executor->injection, &claimed_message)) {
+        return false;
+    }
+    const struct fs_executor_task_t task = {.run = run, .argument = argument};
+    memcpy(claimed_message, &task, FS_EXECUTOR_TASK_SIZE);
+    fs_mpmc_rb_commit_claim(claimed_message);
+    wait_strategy_unpark(executor_park_word(executor));
+    return true;
+}
+
+static inline bool fs_executor_spawn(struct fs_executor_worker_t *const worker, const fs_executor_task_function run,
+                                     void *const argument) {
+    const struct fs_executor_task_t task = {.run = run, .argument = argument};
+    if (!deque_push(&worker->deque, &task)) {
+        return fs_executor_submit(worker->executor, run, argument);
+    }
+    //a parked worker could steal it
+    wait_strategy_unpark(executor_park_word(worker->executor));
+    return true;
+}
+
+static inline bool push_injected_task(uint8_t *const message, void *const context) {
+    const struct fs_executor_worker_t *const worker = (const struct fs_executor_worker_t *) context;
+    struct fs_executor_task_t task;
+    memcpy(&task, message, FS_EXECUTOR_TASK_SIZE);
+    //the batch is sized on the free slots of the deque: only the owner pushes, hence it can't fail
+    deque_push(&worker->deque, &task);
+    return true;
+}
+
+static inline bool take_injected_task(struct fs_executor_worker_t *const worker,
+                                      struct fs_executor_task_t *const task) {
+    const struct fs_executor_deque_t *const deque = &worker->deque;
+    const index_t free_slots = deque->capacity - deque_size(deque);
+    const uint32_t batch = free_slots < FS_EXECUTOR_INJECTION_BATCH ? free_slots : FS_EXECUTOR_INJECTION_BATCH;
+    struct fs_executor_t *const executor = worker->executor;
+    if (batch == 0 ||
+        fs_mpmc_rb_read(executor->injection_buffer, &executor->injection, push_injected_task, batch, worker) == 0) {
+        return false;
+    }
+    return deque_take(deque, task);
+}
+
+static inline uint64_t next_victim_seed(struct fs_executor_worker_t *const worker) {
+    uint64_t seed = worker->victim_seed;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    worker->victim_seed = seed;
+    return seed;
+}
+
+static inline bool steal_task(struct fs_executor_worker_t *const worker, struct fs_executor_task_t *const task) {
+    const struct fs_executor_t *const executor = worker->executor;
+    const uint32_t workers = executor->worker_count;
+    //starting from a random victim spreads the thieves over the workers
+    const uint32_t first_victim = (uint32_t) (next_victim_seed(worker) % workers);
+    for (uint32_t i = 0; i < workers; i++) {
+        const uint32_t victim = (first_victim + i) % workers;
+        if (victim != worker->index && deque_steal(&executor->workers[victim].deque, task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *run_worker(void *const argument) {
+    struct fs_executor_worker_t *const worker = (struct fs_executor_worker_t *) argument;
+    const struct fs_executor_t *const executor = worker->executor;
+    uint32_t idle_count = 0;
+    while (atomic_load_explicit(&executor->running, memory_order_relaxed)) {
+        struct fs_executor_task_t task;
+        if (deque_take(&worker->deque, &task) || take_injected_task(worker, &task) || steal_task(worker, &task)) {
+            task.run(worker, task.argument);
+            idle_count = 0;
+        } else {
+            idle_count = wait_strategy_idle(&worker->wait_strategy, idle_count);
+        }
+    }
+    return NULL;
+}
+
+static inline bool fs_executor_start(struct fs_executor_t *const executor) {
+    atomic_store_explicit(&executor->running, true, memory_order_relaxed);
+    for (uint32_t i = 0; i < executor->worker_count; i++) {
+        struct fs_executor_worker_t *const worker = &executor->workers[i];
+        if (pthread_create(&worker->thread, NULL, run_worker, worker) != 0) {
+            //stop and join only the started ones: the worker count is still read by their steals
+            fs_executor_stop(executor);
+            return false;
+        }
+        executor->started_workers = i + 1;
+    }
+    return true;
+}
+
+static inline void fs_executor_stop(struct fs_executor_t *const executor) {
+    atomic_store_explicit(&executor->running, false, memory_order_relaxed);
+    wait_strategy_unpark(executor_park_word(executor));
+    for (uint32_t i = 0; i < executor->started_workers; i++) {
+        pthread_join(executor->workers[i].thread, NULL);
+    }
+    executor->started_workers = 0;
+    executor->worker_count = 0;
+    rb_free(&executor->memory);
+}
+
+#endif //FRANZ_FLOW_FS_EXECUTOR_C
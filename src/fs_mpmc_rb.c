@@ -0,0 +1,117 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_FS_MPMC_RB_C
+#define FRANZ_FLOW_FS_MPMC_RB_C
+
+#include <stdatomic.h>
+#include "fs_mpmc_rb.h"
+#include "fs_rb.c"
+
+inline static _Atomic uint32_t *
+fs_mpmc_rb_message_state(uint8_t *const buffer, const struct fs_rb_t *const header, const uint64_t position) {
+    return (_Atomic uint32_t *) (buffer + ((position & header->mask) * header->aligned_message_size));
+}
+
+static inline bool new_fs_mpmc_rb(
+        uint8_t *const buffer,
+        struct fs_rb_t *const header,
+        const index_t requested_capacity,
+        const uint32_t message_size) {
+    if (requested_capacity < 2) {
+        return false;
+    }
+    return new_fs_rb(buffer, header, requested_capacity, message_size);
+}
+
+static inline bool try_fs_mpmc_rb_claim(
+        uint8_t *const buffer,
+        const struct fs_rb_t *const header,
+        uint8_t **const claimed_message) {
+    _Atomic uint64_t *const producer_position_address = (_Atomic uint64_t *) header->producer_position;
+    const uint64_t lap_mask = ~((uint64_t) header->mask);
+    uint64_t producer_position = atomic_load_explicit(producer_position_address, memory_order_relaxed);
+    while (true) {
+        const _Atomic uint32_t *const message_state_address =
+                fs_mpmc_rb_message_state(buffer, header, producer_position);
+        const uint32_t message_state = atomic_load_explicit(message_state_address, memory_order_acquire);
+        //the slot is free when its sequence is the lap of the producer position
+        const int32_t difference = (int32_t) (message_state - (uint32_t) (producer_position & lap_mask));
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(producer_position_address, &producer_position,
+                                                      producer_position + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *claimed_message = ((uint8_t *) message_state_address) + MESSAGE_STATE_SIZE;
+                return true;
+            }
+        } else if (difference < 0) {
+            //the consumer of the previous lap hasn't freed it yet: is full
+            return false;
+        } else {
+            //another producer has already claimed it
+            producer_position = atomic_load_explicit(producer_position_address, memory_order_relaxed);
+        }
+    }
+}
+
+static inline void fs_mpmc_rb_commit_claim(const uint8_t *const claimed_message_address) {
+    _Atomic uint32_t *const message_state_address = (_Atomic uint32_t *) (claimed_message_address -
+                                                                          MESSAGE_STATE_SIZE);
+    //no one else can change it until it is committed
+    const uint32_t message_state = atomic_load_explicit(message_state_address, memory_order_relaxed);
+    atomic_store_explicit(message_state_address, message_state + 1, memory_order_release);
+}
+
+inline static uint32_t fs_mpmc_rb_read(
+        uint8_t *const buffer,
+        const struct fs_rb_t *const header,
+        const fs_rb_message_consumer consumer,
+        const uint32_t count, void *const context) {
+    _Atomic uint64_t *const consumer_position_address = (_Atomic uint64_t *) header->consumer_position;
+    const uint64_t lap_mask = ~((uint64_t) header->mask);
+    const index_t capacity = header->capacity;
+    uint64_t consumer_position = atomic_load_explicit(consumer_position_address, memory_order_relaxed);
+    uint32_t available;
+    do {
+        //look for a batch of committed messages to be claimed all at once
+        available = 0;
+        bool claimed_by_others = false;
+        while (available < count) {
+            const uint64_t message_position = consumer_position + available;
+            const _Atomic uint32_t *const message_state_address =
+                    fs_mpmc_rb_message_state(buffer, header, message_position);
+            const uint32_t message_state = atomic_load_explicit(message_state_address, memory_order_acquire);
+            const int32_t difference = (int32_t) (message_state - (uint32_t) ((message_position & lap_mask) + 1));
+            if (difference != 0) {
+                claimed_by_others = difference > 0;
+                break;
+            }
+            available++;
+        }
+        if (available == 0) {
+            if (!claimed_by_others) {
+                return 0;
+            }
+            consumer_position = atomic_load_explicit(consumer_position_address, memory_order_relaxed);
+        } else if (atomic_compare_exchange_weak_explicit(consumer_position_address, &consumer_position,
+                                                         consumer_position + available, memory_order_relaxed,
+                                                         memory_order_relaxed)) {
+            break;
+        }
+    } while (true);
+    uint32_t msg_read = 0;
+    while (msg_read < available) {
+        const uint64_t message_position = consumer_position + msg_read;
+        _Atomic uint32_t *const message_state_address = fs_mpmc_rb_message_state(buffer, header, message_position);
+        //the consumer can't stop before the end of the claimed batch: the others won't read the claimed messages
+        consumer(((uint8_t *) message_state_address) + MESSAGE_STATE_SIZE, context);
+        //free it for the producers of the next lap
+        atomic_store_explicit(message_state_address, (uint32_t) ((message_position & lap_mask) + capacity),
+                              memory_order_release);
+        msg_read++;
+    }
+    return msg_read;
+}
+
+#endif //FRANZ_FLOW_FS_MPMC_RB_C
@@ -0,0 +1,111 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_FS_PIPELINE_C
+#define FRANZ_FLOW_FS_PIPELINE_C
+
+#include <stdatomic.h>
+#include "fs_pipeline.h"
+#include "fs_rb.c"
+
+static const index_t STAGE_POSITION_LENGTH = CACHE_LINE_LENGTH * 2;
+
+static inline index_t
+fs_pipeline_capacity(const index_t requested_capacity, const uint32_t message_size, const uint32_t stages) {
+    //the last stage uses the consumer position of the fs_rb
+    return fs_rb_capacity(requested_capacity, message_size) + ((stages - 1) * STAGE_POSITION_LENGTH);
+}
+
+static inline bool new_fs_pipeline(uint8_t *const buffer, struct fs_pipeline_t *const pipeline,
+                                   const index_t requested_capacity, const uint32_t message_size,
+                                   const uint32_t stages) {
+    if (stages == 0 || stages > FS_PIPELINE_MAX_STAGES ||
+        !new_fs_rb(buffer, &pipeline->ring, requested_capacity, message_size)) {
+        return false;
+    }
+    pipeline->stage_positions = buffer + fs_rb_capacity(requested_capacity, message_size);
+    pipeline->stages = stages;
+    return true;
+}
+
+static inline uint8_t *stage_position(const struct fs_pipeline_t *const pipeline, const uint32_t index) {
+    if (index == pipeline->stages - 1) {
+        return pipeline->ring.consumer_position;
+    }
+    return pipeline->stage_positions + (index * STAGE_POSITION_LENGTH);
+}
+
+static inline bool new_fs_pipeline_stage(const struct fs_pipeline_t *const pipeline,
+                                         struct fs_pipeline_stage_t *const stage, const uint32_t index) {
+    if (index >= pipeline->stages) {
+        return false;
+    }
+    stage->pipeline = pipeline;
+    stage->index = index;
+    stage->position = stage_position(pipeline, index);
+    stage->barrier_position = index == 0 ? NULL : stage_position(pipeline, index - 1);
+    stage->barrier_cache_position = 0;
+    return true;
+}
+
+/**
+ * Returns the position before which the stage can process the messages.
+ */
+static inline uint64_t load_barrier_position(const struct fs_pipeline_stage_t *const stage) {
+    if (stage->barrier_position != NULL) {
+        return atomic_load_explicit((_Atomic uint64_t *) stage->barrier_position, memory_order_acquire);
+    }
+    //the first stage reads the committed message states, but only of the slots already freed by the last stage:
+    //a slot of the previous lap not freed yet is still committed
+    const struct fs_rb_t *const ring = &stage->pipeline->ring;
+    return atomic_load_explicit((_Atomic uint64_t *) ring->consumer_position, memory_order_acquire) +
+           ring->capacity;
+}
+
+static inline uint32_t fs_pipeline_stage_process(uint8_t *const buffer, struct fs_pipeline_stage_t *const stage,
+                                                 const fs_rb_message_consumer consumer,
+                                                 const uint32_t count, void *const context) {
+    const struct fs_rb_t *const ring = &stage->pipeline->ring;
+    const bool first_stage = stage->barrier_position == NULL;
+    const bool last_stage = stage->index == stage->pipeline->stages - 1;
+    _Atomic uint64_t *const position_address = (_Atomic uint64_t *) stage->position;
+    const uint64_t position = atomic_load_explicit(position_address, memory_order_relaxed);
+    uint32_t msg_processed = 0;
+    bool stop = false;
+    while (!stop && msg_processed < count) {
+        const uint64_t message_position = position + msg_processed;
+        //the barrier is loaded again only when the cached one has been reached
+        if (message_position >= stage->barrier_cache_position) {
+            stage->barrier_cache_position = load_barrier_position(stage);
+            if (message_position >= stage->barrier_cache_position) {
+                break;
+            }
+        }
+        uint8_t *const message_state_address = buffer + ((message_position & ring->mask) * ring->aligned_message_size);
+        if (first_stage) {
+            const uint32_t message_state_value = atomic_load_explicit((_Atomic uint32_t *) message_state_address,
+                                                                      memory_order_relaxed);
+            if (message_state_value == MESSAGE_STATE_FREE) {
+                break;
+            }
+            atomic_thread_fence(memory_order_acquire);
+        }
+        stop = !consumer(message_state_address + MESSAGE_STATE_SIZE, context);
+        if (last_stage) {
+            atomic_store_explicit((_Atomic uint32_t *) message_state_address, MESSAGE_STATE_FREE,
+                                  memory_order_release);
+        }
+        msg_processed++;
+    }
+    if (msg_processed != 0) {
+        //a single release for the whole batch: the next stage sees all the changes made on the messages
+        atomic_store_explicit(position_address, position + msg_processed, memory_order_release);
+    }
+    if (last_stage) {
+        RB_COUNTER_INCREMENT(ring->counters, msg_processed != 0 ? RB_READS : RB_EMPTY_READS);
+    }
+    return msg_processed;
+}
+
+#endif //FRANZ_FLOW_FS_PIPELINE_C
@@ -2,9 +2,13 @@
 // Created by forked_franz on 10/02/17.
 //
 
+#ifndef FRANZ_FLOW_FS_RB_C
+#define FRANZ_FLOW_FS_RB_C
+
 #include <stdatomic.h>
 #include "fs_rb.h"
 #include "bytes_utils.c"
+#include "rb_counters.c"
 
 #define MESSAGE_STATE_SIZE 4
 
@@ -13,7 +17,9 @@ static const index_t MESSAGE_STATE_BUSY = 1;
 static const index_t PRODUCER_POSITION_OFFSET = CACHE_LINE_LENGTH * 2;
 static const index_t CONSUMER_CACHE_POSITION_OFFSET = CACHE_LINE_LENGTH * 4;
 static const index_t CONSUMER_POSITION_OFFSET = CACHE_LINE_LENGTH * 6;
-static const index_t TRAILER_LENGTH = CACHE_LINE_LENGTH * 8;
+static const index_t CONSUMER_PARK_OFFSET = CACHE_LINE_LENGTH * 8;
+static const index_t COUNTERS_OFFSET = CACHE_LINE_LENGTH * 10;
+static const index_t TRAILER_LENGTH = (CACHE_LINE_LENGTH * 10) + RB_COUNTERS_LENGTH;
 
 static inline index_t fs_rb_capacity(const index_t requested_capacity, const uint32_t message_size) {
     const index_t next_pow_2_requested_capacity = next_pow_2(requested_capacity);
@@ -22,13 +28,16 @@ static inline index_t fs_rb_capacity(const index_t requested_capacity, const uin
 }
 
 static inline uint64_t fs_rb_load_consumer_position(const struct fs_rb_t *const header, const uint8_t *const buffer) {
-    const uint64_t consumer_position = atomic_load_explicit(header->consumer_position, memory_order_relaxed);
+    //the trailer fields are uint8_t pointers: they must be loaded as uint64_t, not as their first byte
+    const uint64_t consumer_position = atomic_load_explicit((_Atomic uint64_t *) header->consumer_position,
+                                                            memory_order_relaxed);
     return consumer_position;
 }
 
 static inline uint64_t fs_rb_load_producer_position(const struct fs_rb_t *const header, const uint8_t *const buffer) {
-    const uint64_t consumer_position = atomic_load_explicit(header->producer_position, memory_order_relaxed);
-    return consumer_position;
+    const uint64_t producer_position = atomic_load_explicit((_Atomic uint64_t *) header->producer_position,
+                                                            memory_order_relaxed);
+    return producer_position;
 }
 
 static inline bool
@@ -44,10 +53,21 @@ new_fs_rb(uint8_t *const buffer, struct fs_rb_t *const header,
     header->producer_position = buffer + capacity_bytes + PRODUCER_POSITION_OFFSET;
     header->consumer_cache_position = buffer + capacity_bytes + CONSUMER_CACHE_POSITION_OFFSET;
     header->consumer_position = buffer + capacity_bytes + CONSUMER_POSITION_OFFSET;
+    header->consumer_park = buffer + capacity_bytes + CONSUMER_PARK_OFFSET;
+    header->counters = buffer + capacity_bytes + COUNTERS_OFFSET;
     return true;
 }
 
+static inline _Atomic uint32_t *fs_rb_consumer_park_word(const struct fs_rb_t *const header) {
+    return (_Atomic uint32_t *) header->consumer_park;
+}
+
+static inline const uint8_t *fs_rb_counters(const struct fs_rb_t *const header) {
+    return header->counters;
+}
+
 static bool claim_slow_path(uint8_t *const buffer, const index_t message_state_offset,
+                            uint8_t *const counters,
                             uint64_t *const consumer_cache_position_address,
                             const uint64_t consumer_cache_position, const uint32_t max_look_ahead_step,
                             const index_t mask, const index_t aligned_message_size) {
@@ -63,6 +83,7 @@ static bool claim_slow_path(uint8_t *const buffer, const index_t message_state_o
         atomic_thread_fence(memory_order_acquire);
         //can consume
         *consumer_cache_position_address = next_consumer_cache_position;
+        RB_COUNTER_INCREMENT(counters, RB_CONSUMER_CACHE_REFRESHES);
         return true;
     } else {
         //fallback case: try the current claimed message
@@ -71,6 +92,7 @@ static bool claim_slow_path(uint8_t *const buffer, const index_t message_state_o
         const uint32_t claimed_message_state_value = atomic_load_explicit(claimed_message_state_atomic_address,
                                                                           memory_order_relaxed);
         if (claimed_message_state_value != MESSAGE_STATE_FREE) {
+            RB_COUNTER_INCREMENT(counters, RB_FULL_CLAIMS);
             return false;
         }
         atomic_thread_fence(memory_order_acquire);
@@ -79,93 +101,129 @@ static bool claim_slow_path(uint8_t *const buffer, const index_t message_state_o
 }
 
 static inline bool
-try_fs_rb_sp_claim(uint8_t *const buffer,
-                   const struct fs_rb_t *const header,
-                   const uint32_t max_look_ahead_step,
-                   uint8_t **const claimed_message) {
-    const _Atomic uint64_t *const producer_position_address = (_Atomic uint64_t *) header->producer_position;
-    uint64_t *const consumer_cache_position_address = (uint64_t *) header->consumer_cache_position;
-    const index_t mask = header->mask;
-    const index_t aligned_message_size = header->aligned_message_size;
-    const uint64_t consumer_cache_position = *consumer_cache_position_address;
-    const uint64_t producer_position = atomic_load_explicit(producer_position_address, memory_order_relaxed);
-    const index_t message_state_offset = (producer_position & mask) * aligned_message_size;
+fs_rb_sp_claim(uint8_t *const buffer,
+               uint8_t *const producer_position,
+               uint8_t *const consumer_cache_position,
+               uint8_t *const counters,
+               const index_t mask,
+               const index_t aligned_message_size,
+               const uint32_t max_look_ahead_step,
+               uint8_t **const claimed_message) {
+    const _Atomic uint64_t *const producer_position_address = (_Atomic uint64_t *) producer_position;
+    uint64_t *const consumer_cache_position_address = (uint64_t *) consumer_cache_position;
+    const uint64_t consumer_cache_position_value = *consumer_cache_position_address;
+    const uint64_t producer_position_value = atomic_load_explicit(producer_position_address, memory_order_relaxed);
+    const index_t message_state_offset = (producer_position_value & mask) * aligned_message_size;
     //the consumer_cache_position is no longer valid?
-    if (producer_position >= consumer_cache_position &&
-        !claim_slow_path(buffer, message_state_offset, consumer_cache_position_address, consumer_cache_position,
-                         max_look_ahead_step, mask, aligned_message_size)) {
+    if (producer_position_value >= consumer_cache_position_value &&
+        !claim_slow_path(buffer, message_state_offset, counters, consumer_cache_position_address,
+                         consumer_cache_position_value, max_look_ahead_step, mask, aligned_message_size)) {
         return false;
     }
-    atomic_store_explicit(producer_position_address, producer_position + 1, memory_order_relaxed);
+    atomic_store_explicit(producer_position_address, producer_position_value + 1, memory_order_relaxed);
+    RB_COUNTER_INCREMENT(counters, RB_CLAIMS);
     *claimed_message = buffer + message_state_offset + MESSAGE_STATE_SIZE;
     return true;
 }
 
+static inline bool
+try_fs_rb_sp_claim(uint8_t *const buffer,
+                   const struct fs_rb_t *const header,
+                   const uint32_t max_look_ahead_step,
+                   uint8_t **const claimed_message) {
+    return fs_rb_sp_claim(buffer, header->producer_position, header->consumer_cache_position, header->counters,
+                          header->mask, header->aligned_message_size, max_look_ahead_step, claimed_message);
+}
+
 static bool mp_claim_slow_path(const _Atomic uint64_t *const consumer_position_address,
                                const _Atomic uint64_t *const consumer_cache_position_address,
+                               uint8_t *const counters,
                                const int64_t wrap_point, int64_t *consumer_cache_position) {
     //the queue is really full??
     const uint64_t consumer_position = atomic_load_explicit(consumer_position_address, memory_order_relaxed);
     if (consumer_position <= wrap_point) {
+        RB_COUNTER_INCREMENT(counters, RB_FULL_CLAIMS);
         return false;
     } else {
         atomic_thread_fence(memory_order_acquire);
         *consumer_cache_position = consumer_position;
         atomic_store_explicit(consumer_cache_position_address, consumer_position, memory_order_relaxed);
+        RB_COUNTER_INCREMENT(counters, RB_CONSUMER_CACHE_REFRESHES);
         return true;
     }
 }
 
-static inline bool try_fs_rb_mp_claim(
+static inline bool fs_rb_mp_claim(
         uint8_t *const buffer,
-        const struct fs_rb_t *const header,
+        uint8_t *const producer_position,
+        uint8_t *const consumer_cache_position,
+        uint8_t *const consumer_position,
+        uint8_t *const counters,
+        const index_t capacity,
+        const index_t aligned_message_size,
         uint8_t **const claimed_message) {
-    const _Atomic uint64_t *const producer_position_address = (_Atomic uint64_t *) header->producer_position;
-    const _Atomic uint64_t *const consumer_cache_position_address = (_Atomic uint64_t *) header->consumer_cache_position;
-    const _Atomic uint64_t *const consumer_position_address = (_Atomic uint64_t *) header->consumer_position;
-    const index_t mask = header->mask;
-    const index_t capacity = header->capacity;
-    const index_t aligned_message_size = header->aligned_message_size;
-    int64_t producer_position = atomic_load_explicit(producer_position_address, memory_order_acquire);
-    int64_t consumer_cache_position = atomic_load_explicit(consumer_cache_position_address, memory_order_relaxed);
-    do {
-        const int64_t wrap_point = producer_position - capacity;
-        if (consumer_cache_position <= wrap_point) {
+    const _Atomic uint64_t *const producer_position_address = (_Atomic uint64_t *) producer_position;
+    const _Atomic uint64_t *const consumer_cache_position_address = (_Atomic uint64_t *) consumer_cache_position;
+    const _Atomic uint64_t *const consumer_position_address = (_Atomic uint64_t *) consumer_position;
+    const index_t mask = capacity - 1;
+    int64_t producer_position_value = atomic_load_explicit(producer_position_address, memory_order_acquire);
+    int64_t consumer_cache_position_value = atomic_load_explicit(consumer_cache_position_address,
+                                                                 memory_order_relaxed);
+    while (true) {
+        const int64_t wrap_point = producer_position_value - capacity;
+        if (consumer_cache_position_value <= wrap_point) {
             //is *REALLY* full?
-            if (!mp_claim_slow_path(consumer_position_address, consumer_cache_position_address, wrap_point,
-                                    &consumer_cache_position)) {
+            if (!mp_claim_slow_path(consumer_position_address, consumer_cache_position_address, counters, wrap_point,
+                                    &consumer_cache_position_value)) {
                 return false;
             }
         }
-    } while (!atomic_compare_exchange_weak_explicit(producer_position_address, &producer_position,
-                                                    producer_position + 1, memory_order_release, memory_order_relaxed));
-    const index_t message_state_offset = (producer_position & mask) * aligned_message_size;
+        if (atomic_compare_exchange_weak_explicit(producer_position_address, &producer_position_value,
+                                                  producer_position_value + 1, memory_order_release,
+                                                  memory_order_relaxed)) {
+            break;
+        }
+        RB_COUNTER_INCREMENT(counters, RB_CAS_RETRIES);
+    }
+    RB_COUNTER_INCREMENT(counters, RB_CLAIMS);
+    const index_t message_state_offset = (producer_position_value & mask) * aligned_message_size;
     *claimed_message = buffer + message_state_offset + MESSAGE_STATE_SIZE;
     return true;
 }
 
+static inline bool try_fs_rb_mp_claim(
+        uint8_t *const buffer,
+        const struct fs_rb_t *const header,
+        uint8_t **const claimed_message) {
+    return fs_rb_mp_claim(buffer, header->producer_position, header->consumer_cache_position,
+                          header->consumer_position, header->counters, header->capacity,
+                          header->aligned_message_size, claimed_message);
+}
+
 static inline void fs_rb_commit_claim(const uint8_t *const claimed_message_address) {
     const _Atomic uint32_t *const message_state = (_Atomic uint32_t *) (claimed_message_address - MESSAGE_STATE_SIZE);
     atomic_store_explicit(message_state, MESSAGE_STATE_BUSY, memory_order_release);
 }
 
-inline static uint32_t fs_rb_read(
+inline static uint32_t fs_rb_read_messages(
         uint8_t *const buffer,
-        const struct fs_rb_t *const header,
+        uint8_t *const consumer_position,
+        uint8_t *const counters,
+        const index_t mask,
+        const index_t aligned_message_size,
         const fs_rb_message_consumer consumer,
         const uint32_t count, void *const context) {
     uint32_t msg_read = 0;
-    const _Atomic uint64_t *const consumer_position_address = (_Atomic uint64_t *) header->consumer_position;
-    const index_t mask = header->mask;
-    const index_t aligned_message_size = header->aligned_message_size;
-    const uint64_t consumer_position = atomic_load_explicit(consumer_position_address, memory_order_relaxed);
+    const _Atomic uint64_t *const consumer_position_address = (_Atomic uint64_t *) consumer_position;
+    const uint64_t consumer_position_value = atomic_load_explicit(consumer_position_address, memory_order_relaxed);
     while (msg_read < count) {
-        const uint64_t message_position = consumer_position + msg_read;
+        const uint64_t message_position = consumer_position_value + msg_read;
         const index_t message_state_offset = (message_position & mask) * aligned_message_size;
         uint8_t *const message_state_address = buffer + message_state_offset;
         const _Atomic uint32_t *const message_state_atomic_address = (_Atomic uint32_t *) message_state_address;
         const uint32_t message_state_value = atomic_load_explicit(message_state_atomic_address, memory_order_relaxed);
         if (message_state_value == MESSAGE_STATE_FREE) {
+            RB_COUNTER_INCREMENT(counters, msg_read != 0 ? RB_READS : RB_EMPTY_READS);
             return msg_read;
         } else {
             atomic_thread_fence(memory_order_acquire);
@@ -178,21 +236,197 @@ inline static uint32_t fs_rb_read(
             atomic_store_explicit(consumer_position_address, message_position + 1, memory_order_release);
             msg_read++;
             if (stop) {
+                RB_COUNTER_INCREMENT(counters, RB_READS);
                 return msg_read;
             }
         }
     }
+    RB_COUNTER_INCREMENT(counters, msg_read != 0 ? RB_READS : RB_EMPTY_READS);
     return count;
 }
 
-static inline index_t fs_rb_size(const struct fs_rb_t *const header) {
-    const _Atomic uint64_t *consumer_position_address = (_Atomic uint64_t *) header->consumer_position;
-    const _Atomic uint64_t *producer_position_address = (_Atomic uint64_t *) header->producer_position;
+inline static uint32_t fs_rb_read(
+        uint8_t *const buffer,
+        const struct fs_rb_t *const header,
+        const fs_rb_message_consumer consumer,
+        const uint32_t count, void *const context) {
+    return fs_rb_read_messages(buffer, header->consumer_position, header->counters, header->mask,
+                               header->aligned_message_size, consumer, count, context);
+}
+
+inline static uint32_t fs_rb_transfer(
+        uint8_t *const buffer,
+        const struct fs_rb_t *const header,
+        uint8_t *const next_buffer,
+        const struct fs_rb_t *const next_header,
+        const uint32_t max_look_ahead_step,
+        const fs_rb_message_transfer transfer,
+        const uint32_t count, void *const context) {
+    uint32_t msg_transferred = 0;
+    const _Atomic uint64_t *const consumer_position_address = (_Atomic uint64_t *) header->consumer_position;
+    const uint64_t consumer_position_value = atomic_load_explicit(consumer_position_address, memory_order_relaxed);
+    bool stop = false;
+    while (!stop && msg_transferred < count) {
+        const uint64_t message_position = consumer_position_value + msg_transferred;
+        uint8_t *const message_state_address =
+                buffer + ((message_position & header->mask) * header->aligned_message_size);
+        const uint32_t message_state_value = atomic_load_explicit((_Atomic uint32_t *) message_state_address,
+                                                                  memory_order_relaxed);
+        uint8_t *next_message;
+        //the message is claimed on the next ring buffer only if there is any to be transferred
+        if (message_state_value == MESSAGE_STATE_FREE ||
+            !try_fs_rb_sp_claim(next_buffer, next_header, max_look_ahead_step, &next_message)) {
+            break;
+        }
+        atomic_thread_fence(memory_order_acquire);
+        stop = !transfer(message_state_address + MESSAGE_STATE_SIZE, next_message, context);
+        fs_rb_commit_claim(next_message);
+        atomic_store_explicit((_Atomic uint32_t *) message_state_address, MESSAGE_STATE_FREE, memory_order_release);
+        msg_transferred++;
+    }
+    if (msg_transferred != 0) {
+        atomic_store_explicit(consumer_position_address, consumer_position_value + msg_transferred,
+                              memory_order_release);
+    }
+    RB_COUNTER_INCREMENT(header->counters, msg_transferred != 0 ? RB_READS : RB_EMPTY_READS);
+    return msg_transferred;
+}
+
+static inline void fs_rb_scan_cursor(const uint8_t *const buffer, const struct fs_rb_t *const header,
+                                     struct fs_rb_cursor_t *const cursor) {
+    const uint64_t consumer_position = fs_rb_load_consumer_position(header, buffer);
+    cursor->consumer_position = consumer_position;
+    cursor->position = consumer_position;
+}
+
+static inline bool fs_rb_scan_next(uint8_t *const buffer, const struct fs_rb_t *const header,
+                                   struct fs_rb_cursor_t *const cursor, uint8_t **const message) {
+    const uint64_t position = cursor->position;
+    //after capacity messages the scan would meet again the first one
+    if ((position - cursor->consumer_position) >= (uint64_t) header->capacity) {
+        return false;
+    }
+    uint8_t *const message_state_address = buffer + ((position & header->mask) * header->aligned_message_size);
+    const uint32_t message_state_value = atomic_load_explicit((_Atomic uint32_t *) message_state_address,
+                                                              memory_order_relaxed);
+    if (message_state_value == MESSAGE_STATE_FREE) {
+        return false;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    cursor->position = position + 1;
+    *message = message_state_address + MESSAGE_STATE_SIZE;
+    return true;
+}
+
+static inline bool fs_rb_commit_scan(uint8_t *const buffer, const struct fs_rb_t *const header,
+                                     struct fs_rb_cursor_t *const cursor, const uint64_t position) {
+    const _Atomic uint64_t *const consumer_position_address = (_Atomic uint64_t *) header->consumer_position;
     const uint64_t consumer_position = atomic_load_explicit(consumer_position_address, memory_order_relaxed);
-    const uint64_t producer_position = atomic_load_explicit(producer_position_address, memory_order_relaxed);
-    const index_t size = (index_t) (producer_position - consumer_position);
+    //only the scanned messages are known to be committed: any other could be still claimed or already freed
+    if (consumer_position != cursor->consumer_position || position < consumer_position ||
+        position > cursor->position) {
+        return false;
+    }
+    for (uint64_t message_position = consumer_position; message_position < position; message_position++) {
+        uint8_t *const message_state_address =
+                buffer + ((message_position & header->mask) * header->aligned_message_size);
+        atomic_store_explicit((_Atomic uint32_t *) message_state_address, MESSAGE_STATE_FREE, memory_order_release);
+    }
+    //a single consumer position update for the whole scan, after all the message states are freed
+    atomic_store_explicit(consumer_position_address, position, memory_order_release);
+    cursor->consumer_position = position;
+    return true;
+}
+
+static inline index_t fs_rb_positions_size(const uint8_t *const producer_position,
+                                           const uint8_t *const consumer_position) {
+    const _Atomic uint64_t *consumer_position_address = (_Atomic uint64_t *) consumer_position;
+    const _Atomic uint64_t *producer_position_address = (_Atomic uint64_t *) producer_position;
+    const uint64_t consumer_position_value = atomic_load_explicit(consumer_position_address, memory_order_relaxed);
+    const uint64_t producer_position_value = atomic_load_explicit(producer_position_address, memory_order_relaxed);
+    const index_t size = (index_t) (producer_position_value - consumer_position_value);
     return size;
 }
 
+static inline index_t fs_rb_size(const struct fs_rb_t *const header) {
+    return fs_rb_positions_size(header->producer_position, header->consumer_position);
+}
 
+#define FS_RB_ALIGNED_MESSAGE_SIZE(message_size) \
+    (((message_size) + MESSAGE_STATE_SIZE + (MESSAGE_STATE_SIZE - 1)) & ~(MESSAGE_STATE_SIZE - 1))
+
+/**
+ * Defines a family of fs_rb functions specialized for a message size and a capacity known at compile time.
+ *
+ * The generated functions use the same layout of a fs_rb created with the same message size and capacity, but
+ * don't need any {@code struct fs_rb_t}: the trailer offsets, the mask and the aligned message size are constants,
+ * hence the offset math is strength reduced (shifts when the aligned message size is a power of 2) and the copies
+ * of the message content can be unrolled/vectorized by the compiler.
+ *
+ * Given {@code FS_RB_DEFINE(quotes, 28, 4096)} are defined:
+ *  * {@code quotes_capacity()}: as {@code fs_rb_capacity}
+ *  * {@code try_quotes_sp_claim(buffer, max_look_ahead_step, claimed_message)}: as {@code try_fs_rb_sp_claim}
+ *  * {@code try_quotes_mp_claim(buffer, claimed_message)}: as {@code try_fs_rb_mp_claim}
+ *  * {@code quotes_commit_claim(claimed_message)}: as {@code fs_rb_commit_claim}
+ *  * {@code quotes_read(buffer, consumer, count, context)}: as {@code fs_rb_read}
+ *  * {@code quotes_size(buffer)}: as {@code fs_rb_size}
+ *  * {@code quotes_consumer_park_word(buffer)}: as {@code fs_rb_consumer_park_word}
+ *  * {@code quotes_counters(buffer)}: as {@code fs_rb_counters}
+ *
+ * @param name                  the prefix of the generated functions
+ * @param message_size          the size in bytes of each message
+ * @param messages_capacity     the max number of messages the ring buffer can hold: must be a power of 2
+ */
+#define FS_RB_DEFINE(name, message_size, messages_capacity)                                                          \
+_Static_assert((messages_capacity) > 0 && ((messages_capacity) & ((messages_capacity) - 1)) == 0,                   \
+               #name " capacity must be a power of 2");                                                             \
+                                                                                                                    \
+static inline index_t name##_capacity(void) {                                                                       \
+    return ((messages_capacity) * FS_RB_ALIGNED_MESSAGE_SIZE(message_size)) + TRAILER_LENGTH;                       \
+}                                                                                                                   \
+                                                                                                                    \
+static inline uint8_t *name##_trailer(uint8_t *const buffer) {                                                      \
+    return buffer + ((messages_capacity) * FS_RB_ALIGNED_MESSAGE_SIZE(message_size));                               \
+}                                                                                                                   \
+                                                                                                                    \
+static inline bool try_##name##_sp_claim(uint8_t *const buffer, const uint32_t max_look_ahead_step,                 \
+                                         uint8_t **const claimed_message) {                                         \
+    uint8_t *const trailer = name##_trailer(buffer);                                                                \
+    return fs_rb_sp_claim(buffer, trailer + PRODUCER_POSITION_OFFSET, trailer + CONSUMER_CACHE_POSITION_OFFSET,     \
+                          trailer + COUNTERS_OFFSET, (messages_capacity) - 1,                                       \
+                          FS_RB_ALIGNED_MESSAGE_SIZE(message_size), max_look_ahead_step, claimed_message);          \
+}                                                                                                                   \
+                                                                                                                    \
+static inline bool try_##name##_mp_claim(uint8_t *const buffer, uint8_t **const claimed_message) {                  \
+    uint8_t *const trailer = name##_trailer(buffer);                                                                \
+    return fs_rb_mp_claim(buffer, trailer + PRODUCER_POSITION_OFFSET, trailer + CONSUMER_CACHE_POSITION_OFFSET,     \
+                          trailer + CONSUMER_POSITION_OFFSET, trailer + COUNTERS_OFFSET, (messages_capacity),       \
+                          FS_RB_ALIGNED_MESSAGE_SIZE(message_size), claimed_message);                               \
+}                                                                                                                   \
+                                                                                                                    \
+static inline void name##_commit_claim(const uint8_t *const claimed_message) {                                      \
+    fs_rb_commit_claim(claimed_message);                                                                            \
+}                                                                                                                   \
+                                                                                                                    \
+static inline uint32_t name##_read(uint8_t *const buffer, const fs_rb_message_consumer consumer,                    \
+                                   const uint32_t count, void *const context) {                                     \
+    uint8_t *const trailer = name##_trailer(buffer);                                                                \
+    return fs_rb_read_messages(buffer, trailer + CONSUMER_POSITION_OFFSET, trailer + COUNTERS_OFFSET,               \
+                               (messages_capacity) - 1, FS_RB_ALIGNED_MESSAGE_SIZE(message_size), consumer, count,  \
+                               context);                                                                            \
+}                                                                                                                   \
+                                                                                                                    \
+static inline index_t name##_size(uint8_t *const buffer) {                                                          \
+    uint8_t *const trailer = name##_trailer(buffer);                                                                \
+    return fs_rb_positions_size(trailer + PRODUCER_POSITION_OFFSET, trailer + CONSUMER_POSITION_OFFSET);            \
+}                                                                                                                   \
+                                                                                                                    \
+static inline _Atomic uint32_t *name##_consumer_park_word(uint8_t *const buffer) {                                  \
+    return (_Atomic uint32_t *) (name##_trailer(buffer) + CONSUMER_PARK_OFFSET);                                    \
+}                                                                                                                   \
+                                                                                                                    \
+static inline const uint8_t *name##_counters(uint8_t *const buffer) {                                               \
+    return name##_trailer(buffer) + COUNTERS_OFFSET;                                                                \
+}
 
+#endif //FRANZ_FLOW_FS_RB_C
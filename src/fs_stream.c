@@ -2,9 +2,14 @@
 // Created by forked_franz on 18/02/17.
 //
 
+#ifndef FRANZ_FLOW_FS_STREAM_C
+#define FRANZ_FLOW_FS_STREAM_C
+
 #include <stdatomic.h>
+#include <string.h>
 #include "fs_stream.h"
 #include "bytes_utils.c"
+#include "rb_counters.c"
 
 #define MESSAGE_STATE_SIZE 4
 
@@ -13,7 +18,9 @@ static const uint32_t MESSAGE_STATE_BUSY = 1;
 static const uint32_t ACTIVE_CYCLE_INDEX_OFFSET = CACHE_LINE_LENGTH * 2;
 static const uint32_t CONSUMER_CACHE_POSITION_OFFSET = CACHE_LINE_LENGTH * 4;
 static const uint32_t CONSUMER_POSITION_OFFSET = CACHE_LINE_LENGTH * 6;
-static const uint32_t PRODUCERS_CYCLE_CLAIM_OFFSET = CACHE_LINE_LENGTH * 8;
+static const uint32_t CONSUMER_PARK_OFFSET = CACHE_LINE_LENGTH * 8;
+static const uint32_t COUNTERS_OFFSET = CACHE_LINE_LENGTH * 10;
+static const uint32_t PRODUCERS_CYCLE_CLAIM_OFFSET = (CACHE_LINE_LENGTH * 10) + RB_COUNTERS_LENGTH;
 
 static inline uint32_t
 fs_stream_capacity(const uint32_t requested_capacity, const uint32_t message_size, const uint32_t cycles) {
@@ -60,10 +67,18 @@ static inline bool new_fs_stream(
     stream->active_cycle_index = (_Atomic uint32_t *) (buffer + capacity_bytes + ACTIVE_CYCLE_INDEX_OFFSET);
     stream->consumer_cache_position = (_Atomic uint64_t *) (buffer + capacity_bytes + CONSUMER_CACHE_POSITION_OFFSET);
     stream->consumer_position = (_Atomic uint64_t *) (buffer + capacity_bytes + CONSUMER_POSITION_OFFSET);
+    stream->consumer_park = (_Atomic uint32_t *) (buffer + capacity_bytes + CONSUMER_PARK_OFFSET);
+    stream->counters = buffer + capacity_bytes + COUNTERS_OFFSET;
     stream->producers_cycle_claim = (_Atomic uint64_t *) (buffer + capacity_bytes + PRODUCERS_CYCLE_CLAIM_OFFSET);
     return true;
 }
 
+static inline _Atomic uint64_t *
+fs_stream_cycle_claim_address(const struct fs_stream_t *const stream, const uint32_t cycle_index) {
+    //pointer arithmetic on _Atomic uint64_t*: the stride is already sizeof(uint64_t)
+    return stream->producers_cycle_claim + cycle_index;
+}
+
 static void rotate_cycle(const struct fs_stream_t *const stream,
                          const uint32_t active_cycle_index,
                          const uint64_t producer_cycle_claim) {
@@ -71,7 +86,7 @@ static void rotate_cycle(const struct fs_stream_t *const stream,
     //next cycle index?
     const uint32_t next_active_cycle_index = (active_cycle_index + 1) & stream->mask_cycles;
     _Atomic uint64_t *next_producers_active_cycle_claim_address =
-            stream->producers_cycle_claim + (sizeof(uint64_t) * next_active_cycle_index);
+            fs_stream_cycle_claim_address(stream, next_active_cycle_index);
     //next cycle id
     const uint64_t next_cycle_id = (producer_cycle_claim >> 32) + 1;
     const uint64_t next_producer_cycle_claim = next_cycle_id << 32;
@@ -80,6 +95,7 @@ static void rotate_cycle(const struct fs_stream_t *const stream,
                           memory_order_relaxed);
     //write release it changeing the next active cycle index too!
     atomic_store_explicit(stream->active_cycle_index, next_active_cycle_index, memory_order_release);
+    RB_COUNTER_INCREMENT(stream->counters, RB_CYCLE_ROTATIONS);
 }
 
 static bool is_backpressured(const struct fs_stream_t *const stream, const uint64_t producer_position) {
@@ -90,9 +106,11 @@ static bool is_backpressured(const struct fs_stream_t *const stream, const uint6
         atomic_thread_fence(memory_order_acquire);
         //update the cached consumer position for the other producers
         atomic_store_explicit(stream->consumer_cache_position, consumer_position, memory_order_relaxed);
+        RB_COUNTER_INCREMENT(stream->counters, RB_CONSUMER_CACHE_REFRESHES);
         return false;
     } else {
         //backpressured due to reached limit!!
+        RB_COUNTER_INCREMENT(stream->counters, RB_FULL_CLAIMS);
         return true;
     }
 }
@@ -103,7 +121,7 @@ static inline bool fs_stream_try_claim(
     //calculate the claim limit based on consumer_cached_position
     const uint32_t active_cycle_index = atomic_load_explicit(stream->active_cycle_index, memory_order_acquire);
     _Atomic uint64_t *producers_active_cycle_claim_address =
-            stream->producers_cycle_claim + (sizeof(uint64_t) * active_cycle_index);
+            fs_stream_cycle_claim_address(stream, active_cycle_index);
     const uint64_t producer_claim = atomic_load_explicit(producers_active_cycle_claim_address, memory_order_relaxed);
     //translate the claim in an absolute sequence value
     const uint64_t producer_claim_cycle_position = (producer_claim & 0xFFFFFFFF);
@@ -126,6 +144,7 @@ static inline bool fs_stream_try_claim(
         const uint32_t offset =
                 ((active_cycle_index * stream->cycle_length) + cycle_position) * stream->aligned_message_size;
         *claimed_message = stream->buffer + offset + MESSAGE_STATE_SIZE;
+        RB_COUNTER_INCREMENT(stream->counters, RB_CLAIMS);
         return true;
     } else if (cycle_position == stream->cycle_length) {
         rotate_cycle(stream, active_cycle_index, producer_cycle_claim);
@@ -157,6 +176,7 @@ static inline uint32_t fs_stream_read(
         const _Atomic uint32_t *const message_state_atomic_address = (_Atomic uint32_t *) message_state_address;
         const uint32_t message_state_value = atomic_load_explicit(message_state_atomic_address, memory_order_relaxed);
         if (message_state_value == MESSAGE_STATE_FREE) {
+            RB_COUNTER_INCREMENT(stream->counters, msg_read != 0 ? RB_READS : RB_EMPTY_READS);
             return msg_read;
         } else {
             atomic_thread_fence(memory_order_acquire);
@@ -169,17 +189,119 @@ static inline uint32_t fs_stream_read(
             atomic_store_explicit(consumer_position_address, message_position + 1, memory_order_release);
             msg_read++;
             if (stop) {
+                RB_COUNTER_INCREMENT(stream->counters, RB_READS);
                 return msg_read;
             }
         }
     }
+    RB_COUNTER_INCREMENT(stream->counters, msg_read != 0 ? RB_READS : RB_EMPTY_READS);
     return count;
 }
 
+static inline bool fs_stream_try_overwrite_claim(
+        const struct fs_stream_t *const stream,
+        uint8_t **const claimed_message,
+        uint32_t *const claimed_stamp) {
+    const uint32_t active_cycle_index = atomic_load_explicit(stream->active_cycle_index, memory_order_acquire);
+    _Atomic uint64_t *producers_active_cycle_claim_address =
+            fs_stream_cycle_claim_address(stream, active_cycle_index);
+    //no back-pressure: the oldest cycle is overwritten when the active one rotates on it
+    const uint64_t producer_cycle_claim = atomic_fetch_add_explicit(producers_active_cycle_claim_address, 1,
+                                                                    memory_order_relaxed);
+    const uint64_t cycle_position = (producer_cycle_claim & 0xFFFFFFFF);
+    if (cycle_position < stream->cycle_length) {
+        //StoreStore: lapped readers must see the new cycle claim before any of the overwritten content
+        atomic_thread_fence(memory_order_release);
+        const uint32_t offset =
+                ((active_cycle_index * stream->cycle_length) + cycle_position) * stream->aligned_message_size;
+        *claimed_message = stream->buffer + offset + MESSAGE_STATE_SIZE;
+        *claimed_stamp = (uint32_t) ((producer_cycle_claim >> 32) + 1);
+        RB_COUNTER_INCREMENT(stream->counters, RB_CLAIMS);
+        return true;
+    } else if (cycle_position == stream->cycle_length) {
+        rotate_cycle(stream, active_cycle_index, producer_cycle_claim);
+        return false;
+    } else {
+        return false;
+    }
+}
+
+static inline void fs_stream_commit_overwrite_claim(const uint8_t *const claimed_message_address,
+                                                    const uint32_t claimed_stamp) {
+    _Atomic uint32_t *const message_state = (_Atomic uint32_t *) (claimed_message_address - MESSAGE_STATE_SIZE);
+    atomic_store_explicit(message_state, claimed_stamp, memory_order_release);
+}
+
+static inline uint64_t fs_stream_oldest_readable_position(const struct fs_stream_t *const stream) {
+    const uint32_t active_cycle_index = atomic_load_explicit(stream->active_cycle_index, memory_order_acquire);
+    const uint64_t active_cycle_id =
+            atomic_load_explicit(fs_stream_cycle_claim_address(stream, active_cycle_index), memory_order_relaxed) >> 32;
+    //the oldest cycle is the next one to be overwritten: better to skip it too
+    const uint64_t readable_cycles = stream->cycles - 2;
+    const uint64_t oldest_cycle_id = active_cycle_id > readable_cycles ? active_cycle_id - readable_cycles : 0;
+    return oldest_cycle_id * stream->cycle_length;
+}
+
+static inline uint32_t fs_stream_read_lossy(
+        const struct fs_stream_t *const stream,
+        const fs_stream_message_consumer consumer,
+        const uint32_t count, void *const context,
+        uint8_t *const scratch,
+        uint64_t *const lost_messages) {
+    uint32_t msg_read = 0;
+    _Atomic uint64_t *const consumer_position_address = stream->consumer_position;
+    const uint32_t mask = stream->mask;
+    const uint32_t cycle_length = stream->cycle_length;
+    uint8_t *const buffer = stream->buffer;
+    const uint32_t aligned_message_size = stream->aligned_message_size;
+    const uint32_t message_size = aligned_message_size - MESSAGE_STATE_SIZE;
+    uint64_t message_position = atomic_load_explicit(consumer_position_address, memory_order_relaxed);
+    while (msg_read < count) {
+        const uint64_t message_cycle_id = message_position / cycle_length;
+        const uint32_t message_index = message_position & mask;
+        const _Atomic uint64_t *const cycle_claim_address =
+                fs_stream_cycle_claim_address(stream, message_index / cycle_length);
+        const uint64_t cycle_id = atomic_load_explicit(cycle_claim_address, memory_order_acquire) >> 32;
+        if (cycle_id < message_cycle_id) {
+            //the cycle isn't started yet
+            break;
+        }
+        uint8_t *const message_state_address = buffer + (message_index * aligned_message_size);
+        bool lapped = cycle_id > message_cycle_id;
+        if (!lapped) {
+            const uint32_t message_state_value =
+                    atomic_load_explicit((_Atomic uint32_t *) message_state_address, memory_order_acquire);
+            if (message_state_value != (uint32_t) (message_cycle_id + 1)) {
+                //not committed yet
+                break;
+            }
+            memcpy(scratch, message_state_address + MESSAGE_STATE_SIZE, message_size);
+            //LoadLoad: the cycle claim must be read after the message content
+            atomic_thread_fence(memory_order_acquire);
+            lapped = (atomic_load_explicit(cycle_claim_address, memory_order_relaxed) >> 32) != message_cycle_id;
+        }
+        if (lapped) {
+            const uint64_t oldest_readable_position = fs_stream_oldest_readable_position(stream);
+            *lost_messages += oldest_readable_position - message_position;
+            message_position = oldest_readable_position;
+            continue;
+        }
+        message_position++;
+        msg_read++;
+        if (!consumer(scratch, context)) {
+            break;
+        }
+    }
+    //there are no state words to clean: the consumer position is just informative for the producers
+    atomic_store_explicit(consumer_position_address, message_position, memory_order_release);
+    RB_COUNTER_INCREMENT(stream->counters, msg_read != 0 ? RB_READS : RB_EMPTY_READS);
+    return msg_read;
+}
+
 static inline uint64_t fs_stream_load_producer_position(const struct fs_stream_t *const stream) {
     const uint32_t active_cycle_index = atomic_load_explicit(stream->active_cycle_index, memory_order_acquire);
     _Atomic uint64_t *producers_active_cycle_claim_address =
-            stream->producers_cycle_claim + (sizeof(uint64_t) * active_cycle_index);
+            fs_stream_cycle_claim_address(stream, active_cycle_index);
     const uint64_t producer_claim = atomic_load_explicit(producers_active_cycle_claim_address, memory_order_relaxed);
     uint64_t cycle_position = (producer_claim & 0xFFFFFFFF);
     const uint32_t cycle_length = stream->cycle_length;
@@ -201,4 +323,14 @@ static inline uint32_t fs_stream_size(const struct fs_stream_t *const stream) {
     const uint64_t consumer_position = fs_stream_load_consumer_position(stream);
     const uint32_t size = (uint32_t) (producer_position - consumer_position);
     return size;
-}
\ No newline at end of file
+}
+
+static inline _Atomic uint32_t *fs_stream_consumer_park_word(const struct fs_stream_t *const stream) {
+    return stream->consumer_park;
+}
+
+static inline const uint8_t *fs_stream_counters(const struct fs_stream_t *const stream) {
+    return stream->counters;
+}
+
+#endif //FRANZ_FLOW_FS_STREAM_C
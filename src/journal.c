@@ -0,0 +1,187 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_JOURNAL_C
+#define FRANZ_FLOW_JOURNAL_C
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "journal.h"
+#include "vs_rb.c"
+
+//the path prefix + the segment index suffix
+#define JOURNAL_SEGMENT_PATH_LENGTH (JOURNAL_MAX_PATH_LENGTH + 32)
+
+inline static void journal_segment_path(const char *const path_prefix, const uint64_t segment_index,
+                                        char *const path) {
+    snprintf(path, JOURNAL_SEGMENT_PATH_LENGTH, "%s.%020" PRIu64, path_prefix, segment_index);
+}
+
+inline static bool journal_segment_exists(const char *const path_prefix, const uint64_t segment_index) {
+    char path[JOURNAL_SEGMENT_PATH_LENGTH];
+    journal_segment_path(path_prefix, segment_index, path);
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+/**
+ * @returns the length of the records of a segment, that ends on the first zeroed header or at the end of the segment
+ */
+inline static index_t journal_records_length(const uint8_t *const segment, const index_t segment_length) {
+    index_t records_length = 0;
+    while ((segment_length - records_length) >= RECORD_HEADER_LENGTH) {
+        const index_t msg_length = record_length(*((const uint64_t *) (segment + records_length)));
+        if (msg_length <= 0) {
+            break;
+        }
+        records_length += align(msg_length, RECORD_ALIGNMENT);
+    }
+    return records_length;
+}
+
+inline static bool journal_map_segment(struct journal_t *const journal, const bool create) {
+    char path[JOURNAL_SEGMENT_PATH_LENGTH];
+    journal_segment_path(journal->path_prefix, journal->segment_index, path);
+    //never truncate an existing segment: it could hold records not yet replayed
+    const int fd = create ? open(path, O_RDWR | O_CREAT | O_EXCL, (mode_t) 0600) : open(path, O_RDWR);
+    if (fd == -1) {
+        return false;
+    }
+    //a new segment is zero filled, as required to find its end
+    if (create && ftruncate(fd, journal->segment_length) == -1) {
+        close(fd);
+        return false;
+    }
+    void *const mmap_bytes = mmap(NULL, journal->segment_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mmap_bytes == MAP_FAILED) {
+        return false;
+    }
+    journal->segment = (uint8_t *) mmap_bytes;
+    journal->segment_position = create ? 0 : journal_records_length(journal->segment, journal->segment_length);
+    return true;
+}
+
+static inline bool new_journal(struct journal_t *const journal, const char *const path_prefix,
+                               const index_t segment_length) {
+    if (segment_length <= RECORD_HEADER_LENGTH || (segment_length & (RECORD_ALIGNMENT - 1)) != 0 ||
+        strlen(path_prefix) >= JOURNAL_MAX_PATH_LENGTH) {
+        return false;
+    }
+    strcpy(journal->path_prefix, path_prefix);
+    journal->segment_length = segment_length;
+    journal->segment_index = 0;
+    //resume from the last segment
+    while (journal_segment_exists(path_prefix, journal->segment_index + 1)) {
+        journal->segment_index++;
+    }
+    const bool exists = journal_segment_exists(path_prefix, journal->segment_index);
+    return journal_map_segment(journal, !exists);
+}
+
+inline static bool journal_roll_segment(struct journal_t *const journal) {
+    const index_t remaining_bytes = journal->segment_length - journal->segment_position;
+    if (remaining_bytes > 0) {
+        //the replay skips it as any padding record of the ring buffer
+        *((uint64_t *) (journal->segment + journal->segment_position)) =
+                make_header(RECORD_PADDING_MSG_TYPE_ID, remaining_bytes);
+    }
+    //the kernel writes it back even after the unmap: start it now to not pay it all on journal_sync
+    msync(journal->segment, journal->segment_length, MS_ASYNC);
+    munmap(journal->segment, journal->segment_length);
+    journal->segment = NULL;
+    journal->segment_index++;
+    return journal_map_segment(journal, true);
+}
+
+inline static void journal_write(struct journal_t *const journal, const uint8_t *const records,
+                                 const index_t records_length) {
+    memcpy(journal->segment + journal->segment_position, records, records_length);
+    journal->segment_position += records_length;
+}
+
+static inline bool journal_append(struct journal_t *const journal, const uint8_t *const buffer,
+                                  const struct vs_rb_span_t *const span) {
+    const uint8_t *const records = buffer + span->index;
+    //the records are copied in bulk in runs: just the headers are read to find where each run ends
+    index_t run_offset = 0;
+    index_t span_offset = 0;
+    while (span_offset < span->length) {
+        const uint64_t msg_header = *((const uint64_t *) (records + span_offset));
+        const index_t msg_length = align(record_length(msg_header), RECORD_ALIGNMENT);
+        const bool is_padding = message_type_id(msg_header) == RECORD_PADDING_MSG_TYPE_ID;
+        const index_t run_length = span_offset - run_offset;
+        if (is_padding) {
+            //the padding of the ring buffer isn't needed: the segments have their own
+            journal_write(journal, records + run_offset, run_length);
+            span_offset += msg_length;
+            run_offset = span_offset;
+        } else if ((run_length + msg_length) > (journal->segment_length - journal->segment_position)) {
+            journal_write(journal, records + run_offset, run_length);
+            run_offset = span_offset;
+            if (msg_length > journal->segment_length || !journal_roll_segment(journal)) {
+                return false;
+            }
+        } else {
+            span_offset += msg_length;
+        }
+    }
+    journal_write(journal, records + run_offset, span_offset - run_offset);
+    return true;
+}
+
+static inline bool journal_sync(const struct journal_t *const journal) {
+    return msync(journal->segment, journal->segment_length, MS_SYNC) == 0;
+}
+
+static inline bool journal_close(struct journal_t *const journal) {
+    if (journal->segment == NULL) {
+        return true;
+    }
+    const bool synced = journal_sync(journal);
+    const bool unmapped = munmap(journal->segment, journal->segment_length) == 0;
+    journal->segment = NULL;
+    return synced && unmapped;
+}
+
+static inline bool journal_open_segment(const char *const path_prefix, const uint64_t segment_index,
+                                        struct journal_segment_t *const segment) {
+    char path[JOURNAL_SEGMENT_PATH_LENGTH];
+    journal_segment_path(path_prefix, segment_index, path);
+    const int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size <= 0 || st.st_size > INT32_MAX) {
+        close(fd);
+        return false;
+    }
+    const index_t length = (index_t) st.st_size;
+    void *const mmap_bytes = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mmap_bytes == MAP_FAILED) {
+        return false;
+    }
+    segment->buffer = (uint8_t *) mmap_bytes;
+    segment->length = length;
+    segment->span.position = 0;
+    segment->span.index = 0;
+    segment->span.length = journal_records_length(segment->buffer, length);
+    //not needed to iterate it
+    segment->span.msg_count = 0;
+    return true;
+}
+
+static inline bool journal_close_segment(struct journal_segment_t *const segment) {
+    const bool unmapped = munmap(segment->buffer, segment->length) == 0;
+    segment->buffer = NULL;
+    return unmapped;
+}
+
+#endif //FRANZ_FLOW_JOURNAL_C
@@ -0,0 +1,110 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_RB_ALLOC_C
+#define FRANZ_FLOW_RB_ALLOC_C
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "rb_alloc.h"
+
+#define RB_ALLOC_HUGE_PAGE_LENGTH (2 * 1024 * 1024)
+
+//from numaif.h, to not depend on libnuma
+#define RB_ALLOC_MPOL_BIND 2
+#define RB_ALLOC_MPOL_MF_STRICT 1
+#define RB_ALLOC_MPOL_MF_MOVE 2
+
+inline static size_t rb_alloc_align(const size_t value, const size_t pow_2_alignment) {
+    return (value + (pow_2_alignment - 1)) & ~(pow_2_alignment - 1);
+}
+
+inline static uint8_t *rb_alloc_map_huge_pages(const size_t length, bool *const huge_pages) {
+    void *const hugetlb_bytes = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (hugetlb_bytes != MAP_FAILED) {
+        *huge_pages = true;
+        return (uint8_t *) hugetlb_bytes;
+    }
+    //no reserved huge pages: over-map to trim it on a huge page boundary and let khugepaged back it
+    const size_t map_length = length + RB_ALLOC_HUGE_PAGE_LENGTH;
+    void *const mmap_bytes = mmap(NULL, map_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mmap_bytes == MAP_FAILED) {
+        return NULL;
+    }
+    const uintptr_t start = (uintptr_t) mmap_bytes;
+    const uintptr_t aligned_start = rb_alloc_align(start, RB_ALLOC_HUGE_PAGE_LENGTH);
+    if (aligned_start > start) {
+        munmap(mmap_bytes, aligned_start - start);
+    }
+    const uintptr_t end = start + map_length;
+    const uintptr_t aligned_end = aligned_start + length;
+    if (end > aligned_end) {
+        munmap((void *) aligned_end, end - aligned_end);
+    }
+    //best effort: it depends on the transparent huge pages configuration
+    madvise((void *) aligned_start, length, MADV_HUGEPAGE);
+    *huge_pages = false;
+    return (uint8_t *) aligned_start;
+}
+
+inline static bool rb_alloc_bind(uint8_t *const buffer, const size_t length, const int numa_node) {
+    unsigned long node_mask[16] = {0};
+    const unsigned long node_mask_bits = sizeof(node_mask) * 8;
+    if (numa_node < 0 || (unsigned long) numa_node >= node_mask_bits) {
+        return false;
+    }
+    node_mask[numa_node / (sizeof(unsigned long) * 8)] |= 1UL << (numa_node % (sizeof(unsigned long) * 8));
+    return syscall(SYS_mbind, buffer, length, RB_ALLOC_MPOL_BIND, node_mask, node_mask_bits + 1,
+                   RB_ALLOC_MPOL_MF_STRICT | RB_ALLOC_MPOL_MF_MOVE) == 0;
+}
+
+static inline bool rb_alloc(const index_t length, const int numa_node, const int flags,
+                            struct rb_alloc_t *const alloc) {
+    if (length <= 0) {
+        return false;
+    }
+    const bool use_huge_pages = (flags & RB_ALLOC_HUGE_PAGES) != 0;
+    const size_t page_length = use_huge_pages ? RB_ALLOC_HUGE_PAGE_LENGTH : (size_t) sysconf(_SC_PAGESIZE);
+    const size_t map_length = rb_alloc_align((size_t) length, page_length);
+    bool huge_pages = false;
+    uint8_t *buffer;
+    if (use_huge_pages) {
+        buffer = rb_alloc_map_huge_pages(map_length, &huge_pages);
+    } else {
+        void *const mmap_bytes = mmap(NULL, map_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        buffer = mmap_bytes == MAP_FAILED ? NULL : (uint8_t *) mmap_bytes;
+    }
+    if (buffer == NULL) {
+        return false;
+    }
+    //no page is faulted yet: the binding is honoured by all of them
+    if (numa_node != RB_ALLOC_ANY_NUMA_NODE && !rb_alloc_bind(buffer, map_length, numa_node)) {
+        munmap(buffer, map_length);
+        return false;
+    }
+    if ((flags & RB_ALLOC_PREFAULT) != 0) {
+        //writes, because reads would just map the zero page: each small page, in case no huge page is used
+        const size_t small_page_length = (size_t) sysconf(_SC_PAGESIZE);
+        for (size_t offset = 0; offset < map_length; offset += small_page_length) {
+            *((volatile uint8_t *) (buffer + offset)) = 0;
+        }
+    }
+    alloc->buffer = buffer;
+    alloc->length = map_length;
+    alloc->huge_pages = huge_pages;
+    return true;
+}
+
+static inline bool rb_free(struct rb_alloc_t *const alloc) {
+    if (munmap(alloc->buffer, alloc->length) != 0) {
+        return false;
+    }
+    alloc->buffer = NULL;
+    alloc->length = 0;
+    return true;
+}
+
+#endif //FRANZ_FLOW_RB_ALLOC_C
@@ -0,0 +1,39 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_RB_COUNTERS_C
+#define FRANZ_FLOW_RB_COUNTERS_C
+
+#include "rb_counters.h"
+
+static inline uint64_t rb_counter_load(const uint8_t *const counters, const enum rb_counter counter) {
+    const _Atomic uint64_t *const counter_address = ((const _Atomic uint64_t *) counters) + counter;
+    return atomic_load_explicit(counter_address, memory_order_relaxed);
+}
+
+static inline const char *rb_counter_name(const enum rb_counter counter) {
+    switch (counter) {
+        case RB_CLAIMS:
+            return "claims";
+        case RB_FULL_CLAIMS:
+            return "full_claims";
+        case RB_PADDING_RECORDS:
+            return "padding_records";
+        case RB_CONSUMER_CACHE_REFRESHES:
+            return "consumer_cache_refreshes";
+        case RB_CAS_RETRIES:
+            return "cas_retries";
+        case RB_CYCLE_ROTATIONS:
+            return "cycle_rotations";
+        case RB_CONFLATED_UPDATES:
+            return "conflated_updates";
+        case RB_READS:
+            return "reads";
+        case RB_EMPTY_READS:
+            return "empty_reads";
+    }
+    return "unknown";
+}
+
+#endif //FRANZ_FLOW_RB_COUNTERS_C
@@ -0,0 +1,104 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_RB_SET_C
+#define FRANZ_FLOW_RB_SET_C
+
+#include <stdatomic.h>
+#include "rb_set.h"
+#include "bytes_utils.c"
+
+#define RB_SET_RINGS_PER_WORD 64
+//the words skipped at once by the vectorized scan of the bitmap
+#define RB_SET_SCAN_BLOCK_WORDS 4
+
+static inline index_t rb_set_capacity(const uint32_t rings) {
+    const index_t words = (rings + (RB_SET_RINGS_PER_WORD - 1)) / RB_SET_RINGS_PER_WORD;
+    //it is padded to not share any cache line with other data
+    return align(words * sizeof(uint64_t), CACHE_LINE_LENGTH * 2);
+}
+
+static inline bool new_rb_set(uint8_t *const buffer, struct rb_set_t *const set, const uint32_t rings) {
+    if (rings == 0) {
+        return false;
+    }
+    set->bitmap = buffer;
+    set->rings = rings;
+    set->words = (rings + (RB_SET_RINGS_PER_WORD - 1)) / RB_SET_RINGS_PER_WORD;
+    return true;
+}
+
+static inline _Atomic uint64_t *rb_set_word(const struct rb_set_t *const set, const uint32_t word) {
+    return ((_Atomic uint64_t *) set->bitmap) + word;
+}
+
+static inline void rb_set_notify(const struct rb_set_t *const set, const uint32_t ring_id) {
+    _Atomic uint64_t *const word = rb_set_word(set, ring_id / RB_SET_RINGS_PER_WORD);
+    const uint64_t ring_bit = 1UL << (ring_id % RB_SET_RINGS_PER_WORD);
+    //the commit can't be reordered after the load of the bit: it pairs with the consumer clearing the bit before
+    //reading, hence either the producer finds the bit cleared or the consumer finds the message
+    atomic_thread_fence(memory_order_seq_cst);
+    if ((atomic_load_explicit(word, memory_order_relaxed) & ring_bit) == 0) {
+        atomic_fetch_or_explicit(word, ring_bit, memory_order_relaxed);
+    }
+}
+
+/**
+ * Returns the index of the first word not before {@code word} that can have some bit set.
+ */
+static inline uint32_t skip_idle_words(const struct rb_set_t *const set, uint32_t word) {
+#if defined(__SSE2__)
+    //a plain vector load is enough: a bit missed is found on the next poll, because only the consumer clears it
+    const __m128i zero = _mm_setzero_si128();
+    while (word + RB_SET_SCAN_BLOCK_WORDS <= set->words) {
+        const __m128i *const block = (const __m128i *) (set->bitmap + (word * sizeof(uint64_t)));
+        const __m128i bits = _mm_or_si128(_mm_loadu_si128(block), _mm_loadu_si128(block + 1));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(bits, zero)) != 0xFFFF) {
+            return word;
+        }
+        word += RB_SET_SCAN_BLOCK_WORDS;
+    }
+#endif
+    return word;
+}
+
+static inline uint32_t rb_set_poll(const struct rb_set_t *const set, const rb_set_ring_consumer consumer,
+                                   void *const context) {
+    uint32_t visited_rings = 0;
+    uint32_t word = skip_idle_words(set, 0);
+    while (word < set->words) {
+        _Atomic uint64_t *const word_address = rb_set_word(set, word);
+        //the load avoids to write an idle word, hence to steal its cache line from the producers
+        if (atomic_load_explicit(word_address, memory_order_relaxed) != 0) {
+            //to be cleared before reading the ring buffers: see rb_set_notify
+            uint64_t ready_rings = atomic_exchange_explicit(word_address, 0, memory_order_seq_cst);
+            uint64_t rearmed_rings = 0;
+            while (ready_rings != 0) {
+                const uint32_t ring_bit_index = __builtin_ctzll(ready_rings);
+                const uint64_t ring_bit = 1UL << ring_bit_index;
+                ready_rings &= ~ring_bit;
+                visited_rings++;
+                if (consumer((word * RB_SET_RINGS_PER_WORD) + ring_bit_index, context)) {
+                    rearmed_rings |= ring_bit;
+                }
+            }
+            if (rearmed_rings != 0) {
+                atomic_fetch_or_explicit(word_address, rearmed_rings, memory_order_relaxed);
+            }
+        }
+        word = skip_idle_words(set, word + 1);
+    }
+    return visited_rings;
+}
+
+static inline bool rb_set_is_ready(const struct rb_set_t *const set) {
+    for (uint32_t word = 0; word < set->words; word++) {
+        if (atomic_load_explicit(rb_set_word(set, word), memory_order_relaxed) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif //FRANZ_FLOW_RB_SET_C
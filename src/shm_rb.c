@@ -0,0 +1,182 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_SHM_RB_C
+#define FRANZ_FLOW_SHM_RB_C
+
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm_rb.h"
+#include "vs_rb.c"
+#include "fs_rb.c"
+
+static const uint32_t SHM_RB_MAGIC = 0x57464C46;
+static const uint32_t SHM_RB_VERSION = 2;
+
+/**
+ * It lives in the first cache line of the trailer: it is written once on creation and only read then on.
+ */
+struct shm_rb_descriptor_t {
+    uint32_t magic;                     /*  written last, with release semantic                                     */
+    uint32_t version;
+    uint32_t layout;
+    uint32_t message_length;            /*  vs_rb: max message length, fs_rb: message size                          */
+    uint64_t capacity;                  /*  vs_rb: capacity in bytes, fs_rb: capacity in messages                   */
+    uint64_t length;                    /*  total length in bytes, trailer included                                 */
+};
+
+static inline struct shm_rb_descriptor_t *vs_rb_descriptor(const struct vs_rb_t *const header, uint8_t *const buffer) {
+    return (struct shm_rb_descriptor_t *) (buffer + header->capacity);
+}
+
+static inline struct shm_rb_descriptor_t *fs_rb_descriptor(const struct fs_rb_t *const header, uint8_t *const buffer) {
+    return (struct shm_rb_descriptor_t *) (buffer + (header->capacity * header->aligned_message_size));
+}
+
+static inline bool shm_rb_map(const char *const path, const bool create, const index_t length, const int flags,
+                              struct shm_rb_t *const shm) {
+    const bool read_only = !create && (flags & SHM_RB_READ_ONLY) != 0;
+    const int fd = create ? open(path, O_RDWR | O_CREAT | O_TRUNC, (mode_t) 0600) :
+                   open(path, read_only ? O_RDONLY : O_RDWR);
+    if (fd == -1) {
+        return false;
+    }
+    index_t map_length = length;
+    if (create) {
+        //the file is zero filled as required by the producers/consumers
+        if (ftruncate(fd, length) == -1) {
+            close(fd);
+            return false;
+        }
+    } else {
+        struct stat st;
+        if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(struct shm_rb_descriptor_t) ||
+            st.st_size > INT32_MAX) {
+            close(fd);
+            return false;
+        }
+        map_length = (index_t) st.st_size;
+    }
+    const int map_flags = MAP_SHARED | ((flags & SHM_RB_POPULATE) != 0 ? MAP_POPULATE : 0);
+    const int protection = read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+    void *const mmap_bytes = mmap(NULL, map_length, protection, map_flags, fd, 0);
+    //the mapping is still valid after closing the file
+    close(fd);
+    if (mmap_bytes == MAP_FAILED) {
+        return false;
+    }
+    if ((flags & SHM_RB_HUGE_PAGES) != 0) {
+        //best effort: it depends on the shmem transparent huge pages configuration
+        madvise(mmap_bytes, map_length, MADV_HUGEPAGE);
+    }
+    shm->buffer = (uint8_t *) mmap_bytes;
+    shm->length = map_length;
+    return true;
+}
+
+static inline void publish_descriptor(struct shm_rb_descriptor_t *const descriptor, const enum shm_rb_layout layout,
+                                      const uint32_t message_length, const uint64_t capacity,
+                                      const index_t length) {
+    descriptor->version = SHM_RB_VERSION;
+    descriptor->layout = layout;
+    descriptor->message_length = message_length;
+    descriptor->capacity = capacity;
+    descriptor->length = length;
+    //any process that has read the magic will read the rest of the descriptor
+    atomic_store_explicit((_Atomic uint32_t *) &descriptor->magic, SHM_RB_MAGIC, memory_order_release);
+}
+
+static inline bool validate_descriptor(const struct shm_rb_descriptor_t *const descriptor,
+                                       const enum shm_rb_layout layout, const index_t length) {
+    const uint32_t magic = atomic_load_explicit((_Atomic uint32_t *) &descriptor->magic, memory_order_acquire);
+    return magic == SHM_RB_MAGIC &&
+           descriptor->version == SHM_RB_VERSION &&
+           descriptor->layout == layout &&
+           descriptor->length == (uint64_t) length;
+}
+
+static inline bool shm_vs_rb_create(const char *const path, const index_t requested_capacity, const int flags,
+                                    struct shm_rb_t *const shm, struct vs_rb_t *const header) {
+    const index_t length = vs_rb_capacity(requested_capacity);
+    if (!new_vs_rb(header, length) || !shm_rb_map(path, true, length, flags, shm)) {
+        return false;
+    }
+    shm->layout = SHM_VS_RB_LAYOUT;
+    publish_descriptor(vs_rb_descriptor(header, shm->buffer), SHM_VS_RB_LAYOUT, header->max_msg_length,
+                       header->capacity, length);
+    return true;
+}
+
+static inline bool shm_vs_rb_attach(const char *const path, const int flags,
+                                    struct shm_rb_t *const shm, struct vs_rb_t *const header) {
+    if (!shm_rb_map(path, false, 0, flags, shm)) {
+        return false;
+    }
+    shm->layout = SHM_VS_RB_LAYOUT;
+    //the file length determines the layout: the descriptor validates it
+    if (!new_vs_rb(header, shm->length)) {
+        shm_rb_close(shm);
+        return false;
+    }
+    const struct shm_rb_descriptor_t *const descriptor = vs_rb_descriptor(header, shm->buffer);
+    if (!validate_descriptor(descriptor, SHM_VS_RB_LAYOUT, shm->length) ||
+        descriptor->capacity != (uint64_t) header->capacity ||
+        descriptor->message_length != (uint32_t) header->max_msg_length) {
+        shm_rb_close(shm);
+        return false;
+    }
+    return true;
+}
+
+static inline bool shm_fs_rb_create(const char *const path, const index_t requested_capacity,
+                                    const uint32_t message_size, const int flags,
+                                    struct shm_rb_t *const shm, struct fs_rb_t *const header) {
+    const index_t length = fs_rb_capacity(requested_capacity, message_size);
+    if (!shm_rb_map(path, true, length, flags, shm)) {
+        return false;
+    }
+    shm->layout = SHM_FS_RB_LAYOUT;
+    new_fs_rb(shm->buffer, header, requested_capacity, message_size);
+    publish_descriptor(fs_rb_descriptor(header, shm->buffer), SHM_FS_RB_LAYOUT, message_size, header->capacity,
+                       length);
+    return true;
+}
+
+static inline bool shm_fs_rb_attach(const char *const path, const int flags,
+                                    struct shm_rb_t *const shm, struct fs_rb_t *const header) {
+    if (!shm_rb_map(path, false, 0, flags, shm)) {
+        return false;
+    }
+    shm->layout = SHM_FS_RB_LAYOUT;
+    //the descriptor position depends on the capacity: it is at the start of the trailer, at the end of the file
+    if (shm->length < TRAILER_LENGTH) {
+        shm_rb_close(shm);
+        return false;
+    }
+    const struct shm_rb_descriptor_t *const descriptor =
+            (struct shm_rb_descriptor_t *) (shm->buffer + (shm->length - TRAILER_LENGTH));
+    if (!validate_descriptor(descriptor, SHM_FS_RB_LAYOUT, shm->length) ||
+        descriptor->capacity > INT32_MAX ||
+        fs_rb_capacity((index_t) descriptor->capacity, descriptor->message_length) != shm->length) {
+        shm_rb_close(shm);
+        return false;
+    }
+    new_fs_rb(shm->buffer, header, (index_t) descriptor->capacity, descriptor->message_length);
+    return true;
+}
+
+static inline bool shm_rb_close(struct shm_rb_t *const shm) {
+    if (shm->buffer == NULL) {
+        return true;
+    }
+    const bool closed = munmap(shm->buffer, shm->length) == 0;
+    shm->buffer = NULL;
+    shm->length = 0;
+    return closed;
+}
+
+#endif //FRANZ_FLOW_SHM_RB_C
@@ -2,10 +2,14 @@
 // Created by forked_franz on 11/03/17.
 //
 
+#ifndef FRANZ_FLOW_VS_RB_C
+#define FRANZ_FLOW_VS_RB_C
+
 #include <stdatomic.h>
 #include <string.h>
 #include "vs_rb.h"
 #include "bytes_utils.c"
+#include "rb_counters.c"
 
 static const index_t RECORD_HEADER_LENGTH = sizeof(uint32_t) * 2;
 static const index_t RECORD_ALIGNMENT = sizeof(uint32_t) * 2;
@@ -43,6 +47,10 @@ inline static bool check_msg_type_id(const int32_t msgTypeId) {
     return (msgTypeId > 0);
 }
 
+/**
+ * Offset within the trailer for where the mode is stored: the first cache line is left to the shm_rb descriptor.
+ */
+static const index_t RING_BUFFER_MODE_OFFSET = CACHE_LINE_LENGTH;
 /**
  * Offset within the trailer for where the producer value is stored.
  */
@@ -55,10 +63,18 @@ static const index_t RING_BUFFER_CONSUMER_CACHE_POSITION_OFFSET = CACHE_LINE_LEN
  * Offset within the trailer for where the head value is stored.
  */
 static const index_t RING_BUFFER_CONSUMER_POSITION_OFFSET = CACHE_LINE_LENGTH * 6;
+/**
+ * Offset within the trailer for where the consumer park word is stored.
+ */
+static const index_t RING_BUFFER_CONSUMER_PARK_OFFSET = CACHE_LINE_LENGTH * 8;
+/**
+ * Offset within the trailer for where the counters are stored.
+ */
+static const index_t RING_BUFFER_COUNTERS_OFFSET = CACHE_LINE_LENGTH * 10;
 /**
  * Total length of the trailer in bytes.
  */
-static const index_t RING_BUFFER_TRAILER_LENGTH = CACHE_LINE_LENGTH * 8;
+static const index_t RING_BUFFER_TRAILER_LENGTH = (CACHE_LINE_LENGTH * 10) + RB_COUNTERS_LENGTH;
 
 inline static bool ring_buffer_check_capacity(const index_t capacity) {
     return is_pow_2(capacity - RING_BUFFER_TRAILER_LENGTH);
@@ -122,6 +138,32 @@ inline static uint64_t vs_rb_load_producer_position(const struct vs_rb_t *const
     return load_acquire_producer_position(header, buffer);
 }
 
+inline static _Atomic uint32_t *vs_rb_consumer_park_word(const struct vs_rb_t *const header, uint8_t *const buffer) {
+    return (_Atomic uint32_t *) (buffer + header->consumer_park_index);
+}
+
+inline static const uint8_t *vs_rb_counters(const struct vs_rb_t *const header, const uint8_t *const buffer) {
+    return buffer + header->counters_index;
+}
+
+inline static bool vs_rb_set_wrap_mode(const struct vs_rb_t *const header, uint8_t *const buffer) {
+    if (load_acquire_producer_position(header, buffer) != 0) {
+        return false;
+    }
+    atomic_store_explicit((_Atomic uint32_t *) (buffer + header->mode_index), VS_RB_WRAP_MODE, memory_order_release);
+    return true;
+}
+
+inline static enum vs_rb_mode vs_rb_load_mode(const struct vs_rb_t *const header, const uint8_t *const buffer) {
+    //written once before the ring buffer is used: its cache line is never invalidated by the producers/consumers
+    return (enum vs_rb_mode) atomic_load_explicit((_Atomic uint32_t *) (buffer + header->mode_index),
+                                                  memory_order_acquire);
+}
+
+inline static bool is_contiguous_mode(const struct vs_rb_t *const header, const uint8_t *const buffer) {
+    return vs_rb_load_mode(header, buffer) == VS_RB_CONTIGUOUS_MODE;
+}
+
 inline static uint64_t load_acquire_msg_header(const uint8_t *const buffer, const index_t index) {
     const _Atomic uint64_t *msg_header_address = (_Atomic uint64_t *) (buffer + index);
     const uint64_t msg_header_value = atomic_load_explicit(msg_header_address, memory_order_acquire);
@@ -149,8 +191,12 @@ cas_release_producer_position(const struct vs_rb_t *const header, const uint8_t
     //-on the success path the final msg_header's commit is what really matter for the consumer side, and the producer
     // rely on the consumer_position to make any progress
     const _Atomic uint64_t *producer_position_address = (_Atomic uint64_t *) (buffer + header->producer_position_index);
-    return atomic_compare_exchange_strong_explicit(producer_position_address, expected, value, memory_order_release,
-                                                   memory_order_relaxed);
+    const bool claimed = atomic_compare_exchange_strong_explicit(producer_position_address, expected, value,
+                                                                 memory_order_release, memory_order_relaxed);
+    if (!claimed) {
+        RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_CAS_RETRIES);
+    }
+    return claimed;
 }
 
 inline static bool new_vs_rb(struct vs_rb_t *const header, const index_t length) {
@@ -162,11 +208,17 @@ inline static bool new_vs_rb(struct vs_rb_t *const header, const index_t length)
     const index_t producer_position_index = capacity + RING_BUFFER_PRODUCER_POSITION_OFFSET;
     const index_t consumer_cache_position_index = capacity + RING_BUFFER_CONSUMER_CACHE_POSITION_OFFSET;
     const index_t consumer_position_index = capacity + RING_BUFFER_CONSUMER_POSITION_OFFSET;
+    const index_t consumer_park_index = capacity + RING_BUFFER_CONSUMER_PARK_OFFSET;
+    const index_t counters_index = capacity + RING_BUFFER_COUNTERS_OFFSET;
+    const index_t mode_index = capacity + RING_BUFFER_MODE_OFFSET;
     header->capacity = capacity;
     header->max_msg_length = max_msg_length;
     header->producer_position_index = producer_position_index;
     header->consumer_cache_position_index = consumer_cache_position_index;
     header->consumer_position_index = consumer_position_index;
+    header->consumer_park_index = consumer_park_index;
+    header->counters_index = counters_index;
+    header->mode_index = mode_index;
     return true;
 }
 
@@ -180,10 +232,12 @@ try_claim_when_full(const struct vs_rb_t *const header, const uint8_t *const buf
     if (required_capacity > available_capacity) {
         //is full!
         //do not need to refresh the cache position because it doesn't change the producer perception of having a full buffer!
+        RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_FULL_CLAIMS);
         return false;
     } else {
         //refresh the consumer cache position to allow batch writes
         store_consumer_cache_position(header, buffer, last_consumer_position);
+        RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_CONSUMER_CACHE_REFRESHES);
         *consumer_position = last_consumer_position;
         return true;
     }
@@ -197,9 +251,11 @@ inline static bool try_acquire_from_start_of_buffer(const struct vs_rb_t *const
     const index_t consumer_index = last_consumer_position & mask;
     if (required_capacity > consumer_index) {
         //there is not enough space to claim a record from the start of the buffer, the consumer is slow!
+        RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_FULL_CLAIMS);
         return false;
     } else {
         store_consumer_cache_position(header, buffer, last_consumer_position);
+        RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_CONSUMER_CACHE_REFRESHES);
         *consumer_position = last_consumer_position;
         return true;
     }
@@ -258,6 +314,7 @@ vs_rb_try_mp_claim(const struct vs_rb_t *const header, const uint8_t *const buff
     //the cas while succeed doesn't modify the producer_position local value
     if (padding != 0) {
         store_release_msg_header(buffer, producer_index, make_header(RECORD_PADDING_MSG_TYPE_ID, padding));
+        RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_PADDING_RECORDS);
         const uint64_t msg_position = producer_position + padding;
         *claimed_position = msg_position;
         const index_t msg_index = msg_position & mask;
@@ -268,6 +325,7 @@ vs_rb_try_mp_claim(const struct vs_rb_t *const header, const uint8_t *const buff
         const index_t msg_index = producer_index;
         *claimed_index = msg_index;
     }
+    RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_CLAIMS);
     return true;
 }
 
@@ -308,6 +366,7 @@ vs_rb_try_sp_claim(const struct vs_rb_t *const header, const uint8_t *const buff
     store_release_producer_position(header, buffer, new_producer_position);
     if (padding != 0) {
         store_release_msg_header(buffer, producer_index, make_header(RECORD_PADDING_MSG_TYPE_ID, padding));
+        RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_PADDING_RECORDS);
         const uint64_t msg_position = producer_position + padding;
         *claimed_position = msg_position;
         const index_t msg_index = msg_position & mask;
@@ -318,10 +377,220 @@ vs_rb_try_sp_claim(const struct vs_rb_t *const header, const uint8_t *const buff
         const index_t msg_index = producer_index;
         *claimed_index = msg_index;
     }
+    RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_CLAIMS);
+    return true;
+}
+
+
+inline static bool
+batch_required_capacity(const struct vs_rb_t *const header, const index_t *const required_capacities,
+                        const uint32_t count, index_t *const required_batch_capacity) {
+    const index_t capacity = header->capacity;
+    const index_t max_msg_length = header->max_msg_length;
+    index_t batch_capacity = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const index_t required_capacity = required_capacities[i];
+        if (required_capacity > max_msg_length) {
+            return false;
+        }
+        batch_capacity += vs_rb_required_record_capacity(required_capacity);
+        //the whole batch must fit the ring buffer: checked on each step to avoid overflows
+        if (batch_capacity > capacity) {
+            return false;
+        }
+    }
+    *required_batch_capacity = batch_capacity;
+    return true;
+}
+
+inline static index_t batch_padding(const index_t *const required_capacities, const uint32_t count,
+                                    const index_t required_batch_capacity,
+                                    const index_t bytes_until_end_of_buffer, uint32_t *const padded_record) {
+    *padded_record = count;
+    //the whole batch fits the space until the end of the buffer?
+    if (required_batch_capacity <= bytes_until_end_of_buffer) {
+        return 0;
+    }
+    index_t batch_offset = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const index_t required_msg_capacity = vs_rb_required_record_capacity(required_capacities[i]);
+        if (batch_offset + required_msg_capacity > bytes_until_end_of_buffer) {
+            //the padding record will take the place of this record, that will be claimed from the start of the buffer
+            *padded_record = i;
+            return bytes_until_end_of_buffer - batch_offset;
+        }
+        batch_offset += required_msg_capacity;
+    }
+    return 0;
+}
+
+inline static uint64_t
+claim_batch_indexes(const uint8_t *const buffer, const index_t *const required_capacities, const uint32_t count,
+                    const uint64_t producer_position, const index_t mask,
+                    const index_t padding, const uint32_t padded_record, index_t *const claimed_indexes) {
+    uint64_t msg_position = producer_position;
+    uint64_t last_msg_position = producer_position;
+    for (uint32_t i = 0; i < count; i++) {
+        //the earlier records can end exactly at the end of the buffer: no padding record is needed then
+        if (i == padded_record && padding != 0) {
+            store_release_msg_header(buffer, msg_position & mask, make_header(RECORD_PADDING_MSG_TYPE_ID, padding));
+            msg_position += padding;
+        }
+        claimed_indexes[i] = msg_position & mask;
+        last_msg_position = msg_position;
+        msg_position += vs_rb_required_record_capacity(required_capacities[i]);
+    }
+    return last_msg_position;
+}
+
+inline static bool
+vs_rb_try_mp_batch_claim(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                         const index_t *const required_capacities, const uint32_t count,
+                         uint64_t *const claimed_position, index_t *const claimed_indexes) {
+    index_t required_batch_capacity = 0;
+    if (count == 0 || !batch_required_capacity(header, required_capacities, count, &required_batch_capacity)) {
+        return false;
+    }
+    const index_t capacity = header->capacity;
+    const index_t mask = capacity - 1;
+    uint64_t consumer_position = load_consumer_cache_position(header, buffer);
+    index_t padding = 0;
+    uint32_t padded_record = count;
+    uint64_t producer_position = load_acquire_producer_position(header, buffer);
+    index_t required_claim_capacity = 0;
+    do {
+        //the padding depends on where the batch starts: it must be computed again after any failed cas
+        padding = batch_padding(required_capacities, count, required_batch_capacity,
+                                capacity - (producer_position & mask), &padded_record);
+        required_claim_capacity = required_batch_capacity + padding;
+        const int64_t size = producer_position - consumer_position;
+        //the available capacity could be negative due to a stale/cached consumer_position value
+        const int64_t available_capacity = (int64_t) capacity - size;
+        if (required_claim_capacity > available_capacity) {
+            if (!try_claim_when_full(header, buffer, producer_position, required_claim_capacity, &consumer_position)) {
+                return false;
+            }
+        }
+    } while (!cas_release_producer_position(header, buffer, &producer_position,
+                                            producer_position + required_claim_capacity));
+    *claimed_position = claim_batch_indexes(buffer, required_capacities, count, producer_position, mask, padding,
+                                            padded_record, claimed_indexes);
+    if (padding != 0) {
+        RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_PADDING_RECORDS);
+    }
+    RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_CLAIMS);
+    return true;
+}
+
+inline static bool
+vs_rb_try_sp_batch_claim(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                         const index_t *const required_capacities, const uint32_t count,
+                         uint64_t *const claimed_position, index_t *const claimed_indexes) {
+    index_t required_batch_capacity = 0;
+    if (count == 0 || !batch_required_capacity(header, required_capacities, count, &required_batch_capacity)) {
+        return false;
+    }
+    const index_t capacity = header->capacity;
+    const index_t mask = capacity - 1;
+    uint64_t consumer_position = load_consumer_cache_position(header, buffer);
+    const uint64_t producer_position = load_producer_position(header, buffer);
+    uint32_t padded_record = count;
+    const index_t padding = batch_padding(required_capacities, count, required_batch_capacity,
+                                          capacity - (producer_position & mask), &padded_record);
+    const index_t required_claim_capacity = required_batch_capacity + padding;
+    const int64_t size = producer_position - consumer_position;
+    const int64_t available_capacity = (int64_t) capacity - size;
+    //a single check is enough: the padding is already accounted into the required claim capacity
+    if (required_claim_capacity > available_capacity) {
+        if (!try_claim_when_full(header, buffer, producer_position, required_claim_capacity, &consumer_position)) {
+            return false;
+        }
+    }
+    store_release_producer_position(header, buffer, producer_position + required_claim_capacity);
+    *claimed_position = claim_batch_indexes(buffer, required_capacities, count, producer_position, mask, padding,
+                                            padded_record, claimed_indexes);
+    if (padding != 0) {
+        RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_PADDING_RECORDS);
+    }
+    RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_CLAIMS);
     return true;
 }
 
 
+inline static bool
+vs_rb_try_mp_wrap_claim(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                        const index_t required_capacity,
+                        uint64_t *const claimed_position, index_t *const claimed_index) {
+    //a contiguous reader would hand out the content of a wrapped record past the end of the buffer
+    if (required_capacity > header->max_msg_length || is_contiguous_mode(header, buffer)) {
+        return false;
+    }
+    const index_t capacity = header->capacity;
+    uint64_t consumer_position = load_consumer_cache_position(header, buffer);
+    const index_t required_msg_capacity = vs_rb_required_record_capacity(required_capacity);
+    uint64_t producer_position = load_acquire_producer_position(header, buffer);
+    do {
+        const int64_t size = producer_position - consumer_position;
+        //the available capacity could be negative due to a stale/cached consumer_position value
+        const int64_t available_capacity = (int64_t) capacity - size;
+        if (required_msg_capacity > available_capacity) {
+            if (!try_claim_when_full(header, buffer, producer_position, required_msg_capacity, &consumer_position)) {
+                return false;
+            }
+        }
+        //no padding: the record continues from the start of the buffer if it doesn't fit until the end of it
+    } while (!cas_release_producer_position(header, buffer, &producer_position,
+                                            producer_position + required_msg_capacity));
+    *claimed_position = producer_position;
+    *claimed_index = producer_position & (capacity - 1);
+    RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_CLAIMS);
+    return true;
+}
+
+inline static bool
+vs_rb_try_sp_wrap_claim(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                        const index_t required_capacity,
+                        uint64_t *const claimed_position, index_t *const claimed_index) {
+    if (required_capacity > header->max_msg_length || is_contiguous_mode(header, buffer)) {
+        return false;
+    }
+    const index_t capacity = header->capacity;
+    uint64_t consumer_position = load_consumer_cache_position(header, buffer);
+    const uint64_t producer_position = load_producer_position(header, buffer);
+    const index_t required_msg_capacity = vs_rb_required_record_capacity(required_capacity);
+    const int64_t size = producer_position - consumer_position;
+    const int64_t available_capacity = (int64_t) capacity - size;
+    if (required_msg_capacity > available_capacity) {
+        if (!try_claim_when_full(header, buffer, producer_position, required_msg_capacity, &consumer_position)) {
+            return false;
+        }
+    }
+    store_release_producer_position(header, buffer, producer_position + required_msg_capacity);
+    *claimed_position = producer_position;
+    *claimed_index = producer_position & (capacity - 1);
+    RB_COUNTER_INCREMENT(buffer + header->counters_index, RB_CLAIMS);
+    return true;
+}
+
+inline static uint32_t
+vs_rb_record_segments(const struct vs_rb_t *const header, const uint8_t *const buffer, const index_t msg_index,
+                      const index_t msg_content_length, struct iovec *const segments) {
+    //the record header never wraps: the records are aligned to it and the capacity is a power of 2
+    const index_t msg_content_index = vs_rb_encoded_msg_offset(msg_index) & (header->capacity - 1);
+    const index_t bytes_until_end_of_buffer = header->capacity - msg_content_index;
+    segments[0].iov_base = (uint8_t *) buffer + msg_content_index;
+    if (msg_content_length <= bytes_until_end_of_buffer) {
+        segments[0].iov_len = msg_content_length;
+        segments[1].iov_base = (uint8_t *) buffer;
+        segments[1].iov_len = 0;
+        return 1;
+    }
+    segments[0].iov_len = bytes_until_end_of_buffer;
+    segments[1].iov_base = (uint8_t *) buffer;
+    segments[1].iov_len = msg_content_length - bytes_until_end_of_buffer;
+    return 2;
+}
+
 inline static bool
 vs_rb_commit_claim(const uint8_t *const buffer, const index_t msg_index, const uint32_t msg_type_id,
                    const index_t msg_content_length) {
@@ -333,6 +602,148 @@ vs_rb_commit_claim(const uint8_t *const buffer, const index_t msg_index, const u
     return true;
 }
 
+inline static bool
+vs_rb_commit_batch_claim(const uint8_t *const buffer, const index_t *const msg_indexes,
+                         const uint32_t *const msg_type_ids, const index_t *const msg_content_lengths,
+                         const uint32_t count) {
+    //validate all the records before committing any of them
+    for (uint32_t i = 0; i < count; i++) {
+        if (!check_msg_type_id(msg_type_ids[i])) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        store_release_msg_header(buffer, msg_indexes[i],
+                                 make_header(msg_type_ids[i], msg_content_lengths[i] + RECORD_HEADER_LENGTH));
+    }
+    return true;
+}
+
+inline static bool segments_length(const struct vs_rb_t *const header, const struct iovec *const segments,
+                                   const uint32_t segments_count, index_t *const length) {
+    uint64_t total_length = 0;
+    for (uint32_t i = 0; i < segments_count; i++) {
+        total_length += segments[i].iov_len;
+        //checked on each step to avoid overflows
+        if (total_length > (uint64_t) header->max_msg_length) {
+            return false;
+        }
+    }
+    *length = (index_t) total_length;
+    return true;
+}
+
+inline static void copy_segments(uint8_t *const destination, const struct iovec *const segments,
+                                 const uint32_t segments_count, const index_t length) {
+    const bool non_temporal = length >= NON_TEMPORAL_COPY_THRESHOLD;
+    index_t offset = 0;
+    for (uint32_t i = 0; i < segments_count; i++) {
+        const index_t segment_length = (index_t) segments[i].iov_len;
+        if (non_temporal) {
+            copy_bytes_non_temporal(destination + offset, segments[i].iov_base, segment_length);
+        } else {
+            memcpy(destination + offset, segments[i].iov_base, segment_length);
+        }
+        offset += segment_length;
+    }
+}
+
+inline static bool
+try_offer(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t msg_type_id,
+          const struct iovec *const segments, const uint32_t segments_count, const bool multi_producer) {
+    index_t msg_content_length;
+    //validate everything before claiming: a claimed record must always be committed
+    if (!check_msg_type_id(msg_type_id) || !segments_length(header, segments, segments_count, &msg_content_length)) {
+        return false;
+    }
+    uint64_t claimed_position;
+    index_t claimed_index;
+    const bool claimed = multi_producer ?
+                         vs_rb_try_mp_claim(header, buffer, msg_content_length, &claimed_position, &claimed_index) :
+                         vs_rb_try_sp_claim(header, buffer, msg_content_length, &claimed_position, &claimed_index);
+    if (!claimed) {
+        return false;
+    }
+    copy_segments(buffer + vs_rb_encoded_msg_offset(claimed_index), segments, segments_count, msg_content_length);
+    return vs_rb_commit_claim(buffer, claimed_index, msg_type_id, msg_content_length);
+}
+
+inline static bool
+vs_rb_try_sp_offer(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t msg_type_id,
+                   const struct iovec *const segments, const uint32_t segments_count) {
+    return try_offer(header, buffer, msg_type_id, segments, segments_count, false);
+}
+
+inline static bool
+vs_rb_try_mp_offer(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t msg_type_id,
+                   const struct iovec *const segments, const uint32_t segments_count) {
+    return try_offer(header, buffer, msg_type_id, segments, segments_count, true);
+}
+
+inline static bool
+try_offer_batch(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t *const msg_type_ids,
+                const struct iovec *const messages, const uint32_t count, const bool multi_producer) {
+    if (count > VS_RB_MAX_OFFER_BATCH) {
+        return false;
+    }
+    index_t msg_content_lengths[VS_RB_MAX_OFFER_BATCH];
+    index_t claimed_indexes[VS_RB_MAX_OFFER_BATCH];
+    for (uint32_t i = 0; i < count; i++) {
+        if (!check_msg_type_id(msg_type_ids[i]) || !segments_length(header, &messages[i], 1, &msg_content_lengths[i])) {
+            return false;
+        }
+    }
+    uint64_t claimed_position;
+    const bool claimed = multi_producer ?
+                         vs_rb_try_mp_batch_claim(header, buffer, msg_content_lengths, count, &claimed_position,
+                                                  claimed_indexes) :
+                         vs_rb_try_sp_batch_claim(header, buffer, msg_content_lengths, count, &claimed_position,
+                                                  claimed_indexes);
+    if (!claimed) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(buffer + vs_rb_encoded_msg_offset(claimed_indexes[i]), messages[i].iov_base, msg_content_lengths[i]);
+    }
+    return vs_rb_commit_batch_claim(buffer, claimed_indexes, msg_type_ids, msg_content_lengths, count);
+}
+
+inline static bool
+vs_rb_try_sp_offer_batch(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t *const msg_type_ids,
+                         const struct iovec *const messages, const uint32_t count) {
+    return try_offer_batch(header, buffer, msg_type_ids, messages, count, false);
+}
+
+inline static bool
+vs_rb_try_mp_offer_batch(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t *const msg_type_ids,
+                         const struct iovec *const messages, const uint32_t count) {
+    return try_offer_batch(header, buffer, msg_type_ids, messages, count, true);
+}
+
+inline static void
+release_consumed_bytes(const struct vs_rb_t *const header, uint8_t *const buffer, const uint64_t consumer_position,
+                       const index_t consumer_index, const index_t bytes_consumed, const enum vs_rb_zeroing zeroing) {
+    //zeroes all the consumed bytes: the producers rely on it to claim new records
+    const index_t bytes_until_end_of_buffer = header->capacity - consumer_index;
+    //the consumed bytes could continue from the start of the buffer
+    const index_t wrapped_bytes_consumed =
+            bytes_consumed > bytes_until_end_of_buffer ? bytes_consumed - bytes_until_end_of_buffer : 0;
+    const index_t contiguous_bytes_consumed = bytes_consumed - wrapped_bytes_consumed;
+    if (zeroing == VS_RB_ZEROING_NON_TEMPORAL) {
+        zero_bytes_non_temporal(buffer + consumer_index, contiguous_bytes_consumed);
+        if (wrapped_bytes_consumed != 0) {
+            zero_bytes_non_temporal(buffer, wrapped_bytes_consumed);
+        }
+    } else {
+        zero_bytes(buffer + consumer_index, contiguous_bytes_consumed);
+        if (wrapped_bytes_consumed != 0) {
+            zero_bytes(buffer, wrapped_bytes_consumed);
+        }
+    }
+    const uint64_t new_consumer_position = consumer_position + bytes_consumed;
+    store_release_consumer_position(header, buffer, new_consumer_position);
+}
+
 //declare a const pointer to a function with this signature
 typedef bool(*const vs_rb_message_consumer)(const uint32_t, const uint8_t *const,
                                             const index_t,
@@ -341,15 +752,21 @@ typedef bool(*const vs_rb_message_consumer)(const uint32_t, const uint8_t *const
 inline static uint32_t vs_rb_read(const struct vs_rb_t *const header, uint8_t *const buffer,
                                   const vs_rb_message_consumer consumer,
                                   const uint32_t count, void *context) {
+    //the content of a wrapped record isn't contiguous: it can be read only by vs_rb_read_segments
+    if (!is_contiguous_mode(header, buffer)) {
+        return 0;
+    }
     uint32_t msg_read = 0;
     const uint64_t consumer_position = load_consumer_position(header, buffer);
     const index_t capacity = header->capacity;
-    const index_t consumer_index = consumer_position & (capacity - 1);
-    const uint32_t remaining_bytes = capacity - consumer_index;
+    const index_t mask = capacity - 1;
+    const index_t consumer_index = consumer_position & mask;
     index_t bytes_consumed = 0;
     bool stop = false;
-    while (!stop && (bytes_consumed < remaining_bytes) && (msg_read < count)) {
-        const index_t msg_index = consumer_index + bytes_consumed;
+    //it continues from the start of the buffer after the end of it, but can't read more than capacity bytes:
+    //the consumed bytes are zeroed only at the end, hence it must not visit again an already consumed record
+    while (!stop && (bytes_consumed < capacity) && (msg_read < count)) {
+        const index_t msg_index = (consumer_index + bytes_consumed) & mask;
         const uint64_t msg_header = load_acquire_msg_header(buffer, msg_index);
         const index_t msg_length = record_length(msg_header);
         if (msg_length <= 0) {
@@ -368,15 +785,235 @@ inline static uint32_t vs_rb_read(const struct vs_rb_t *const header, uint8_t *c
         }
     }
     if (bytes_consumed != 0) {
-        //zeroes all the consumed bytes
-        void *consumer_start_offset = buffer + consumer_index;
-        memset(consumer_start_offset, 0, bytes_consumed);
-        const uint64_t new_consumer_position = consumer_position + bytes_consumed;
-        store_release_consumer_position(header, buffer, new_consumer_position);
+        release_consumed_bytes(header, buffer, consumer_position, consumer_index, bytes_consumed,
+                               VS_RB_ZEROING_TEMPORAL);
+    }
+    RB_COUNTER_INCREMENT(buffer + header->counters_index, msg_read != 0 ? RB_READS : RB_EMPTY_READS);
+    return msg_read;
+}
+
+inline static uint32_t vs_rb_controlled_read(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                             const vs_rb_controlled_consumer consumer,
+                                             const uint32_t count, void *context) {
+    if (!is_contiguous_mode(header, buffer)) {
+        return 0;
+    }
+    uint32_t msg_read = 0;
+    uint64_t consumer_position = load_consumer_position(header, buffer);
+    const index_t capacity = header->capacity;
+    const index_t mask = capacity - 1;
+    index_t consumer_index = consumer_position & mask;
+    //the bytes consumed but not released yet
+    index_t bytes_consumed = 0;
+    bool stop = false;
+    while (!stop && (bytes_consumed < capacity) && (msg_read < count)) {
+        const index_t msg_index = (consumer_index + bytes_consumed) & mask;
+        const uint64_t msg_header = load_acquire_msg_header(buffer, msg_index);
+        const index_t msg_length = record_length(msg_header);
+        if (msg_length <= 0) {
+            break;
+        }
+        const index_t required_msg_length = align(msg_length, RECORD_ALIGNMENT);
+        const uint32_t msg_type_id = message_type_id(msg_header);
+        if (msg_type_id == RECORD_PADDING_MSG_TYPE_ID) {
+            bytes_consumed += required_msg_length;
+            continue;
+        }
+        const index_t msg_content_length = msg_length - RECORD_HEADER_LENGTH;
+        const index_t msg_content_index = msg_index + RECORD_HEADER_LENGTH;
+        const enum vs_rb_control_action action = consumer(msg_type_id, buffer, msg_content_index, msg_content_length,
+                                                          context);
+        switch (action) {
+            case VS_RB_ABORT:
+                //the record will be read again by the next read
+                stop = true;
+                break;
+            case VS_RB_BREAK:
+                bytes_consumed += required_msg_length;
+                msg_read++;
+                stop = true;
+                break;
+            case VS_RB_COMMIT:
+                bytes_consumed += required_msg_length;
+                msg_read++;
+                release_consumed_bytes(header, buffer, consumer_position, consumer_index, bytes_consumed,
+                                       VS_RB_ZEROING_TEMPORAL);
+                consumer_position += bytes_consumed;
+                consumer_index = consumer_position & mask;
+                bytes_consumed = 0;
+                break;
+            case VS_RB_CONTINUE:
+                bytes_consumed += required_msg_length;
+                msg_read++;
+                break;
+        }
+    }
+    if (bytes_consumed != 0) {
+        release_consumed_bytes(header, buffer, consumer_position, consumer_index, bytes_consumed,
+                               VS_RB_ZEROING_TEMPORAL);
+    }
+    RB_COUNTER_INCREMENT(buffer + header->counters_index, msg_read != 0 ? RB_READS : RB_EMPTY_READS);
+    return msg_read;
+}
+
+inline static uint32_t vs_rb_read_segments(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                           const vs_rb_segments_consumer consumer,
+                                           const uint32_t count, void *context) {
+    uint32_t msg_read = 0;
+    const uint64_t consumer_position = load_consumer_position(header, buffer);
+    const index_t capacity = header->capacity;
+    const index_t mask = capacity - 1;
+    const index_t consumer_index = consumer_position & mask;
+    index_t bytes_consumed = 0;
+    bool stop = false;
+    struct iovec segments[VS_RB_MAX_SEGMENTS];
+    while (!stop && (bytes_consumed < capacity) && (msg_read < count)) {
+        const index_t msg_index = (consumer_index + bytes_consumed) & mask;
+        const uint64_t msg_header = load_acquire_msg_header(buffer, msg_index);
+        const index_t msg_length = record_length(msg_header);
+        if (msg_length <= 0) {
+            stop = true;
+        } else {
+            bytes_consumed += align(msg_length, RECORD_ALIGNMENT);
+            const uint32_t msg_type_id = message_type_id(msg_header);
+            if (msg_type_id != RECORD_PADDING_MSG_TYPE_ID) {
+                msg_read++;
+                const uint32_t segments_count = vs_rb_record_segments(header, buffer, msg_index,
+                                                                      msg_length - RECORD_HEADER_LENGTH, segments);
+                stop = !consumer(msg_type_id, segments, segments_count, context);
+            }
+        }
+    }
+    if (bytes_consumed != 0) {
+        release_consumed_bytes(header, buffer, consumer_position, consumer_index, bytes_consumed,
+                               VS_RB_ZEROING_TEMPORAL);
     }
+    RB_COUNTER_INCREMENT(buffer + header->counters_index, msg_read != 0 ? RB_READS : RB_EMPTY_READS);
     return msg_read;
 }
 
+inline static uint32_t vs_rb_drain(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                                   const uint32_t count, struct vs_rb_span_t *const span) {
+    uint32_t msg_read = 0;
+    const uint64_t consumer_position = load_consumer_position(header, buffer);
+    const index_t capacity = header->capacity;
+    const index_t consumer_index = consumer_position & (capacity - 1);
+    //an empty span from a ring buffer in wrap mode: the content of its records can't be handed out contiguously
+    const index_t remaining_bytes = is_contiguous_mode(header, buffer) ? capacity - consumer_index : 0;
+    index_t bytes_consumed = 0;
+    //the headers are acquired just once here: the span iteration can read them without any ordering constraint
+    while ((bytes_consumed < remaining_bytes) && (msg_read < count)) {
+        const uint64_t msg_header = load_acquire_msg_header(buffer, consumer_index + bytes_consumed);
+        const index_t msg_length = record_length(msg_header);
+        if (msg_length <= 0) {
+            break;
+        }
+        bytes_consumed += align(msg_length, RECORD_ALIGNMENT);
+        if (message_type_id(msg_header) != RECORD_PADDING_MSG_TYPE_ID) {
+            msg_read++;
+        }
+    }
+    span->position = consumer_position;
+    span->index = consumer_index;
+    span->length = bytes_consumed;
+    span->msg_count = msg_read;
+    RB_COUNTER_INCREMENT(buffer + header->counters_index, msg_read != 0 ? RB_READS : RB_EMPTY_READS);
+    return msg_read;
+}
+
+inline static bool vs_rb_span_next(const uint8_t *const buffer, const struct vs_rb_span_t *const span,
+                                   index_t *const span_offset, uint32_t *const msg_type_id,
+                                   index_t *const msg_content_index, index_t *const msg_content_length) {
+    index_t offset = *span_offset;
+    while (offset < span->length) {
+        const index_t msg_index = span->index + offset;
+        const uint64_t msg_header = *((const uint64_t *) (buffer + msg_index));
+        const index_t msg_length = record_length(msg_header);
+        offset += align(msg_length, RECORD_ALIGNMENT);
+        const uint32_t type_id = message_type_id(msg_header);
+        if (type_id != RECORD_PADDING_MSG_TYPE_ID) {
+            *span_offset = offset;
+            *msg_type_id = type_id;
+            *msg_content_index = msg_index + RECORD_HEADER_LENGTH;
+            *msg_content_length = msg_length - RECORD_HEADER_LENGTH;
+            return true;
+        }
+    }
+    *span_offset = offset;
+    return false;
+}
+
+inline static void vs_rb_release_span(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                      const struct vs_rb_span_t *const span, const enum vs_rb_zeroing zeroing) {
+    if (span->length != 0) {
+        release_consumed_bytes(header, buffer, span->position, span->index, span->length, zeroing);
+    }
+}
+
+inline static void vs_rb_scan_cursor(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                                     struct vs_rb_cursor_t *const cursor) {
+    const uint64_t consumer_position = load_consumer_position(header, buffer);
+    cursor->consumer_position = consumer_position;
+    cursor->position = consumer_position;
+}
+
+inline static bool vs_rb_scan_next(const struct vs_rb_t *const header, const uint8_t *const buffer,
+                                   struct vs_rb_cursor_t *const cursor, uint32_t *const msg_type_id,
+                                   index_t *const msg_content_index, index_t *const msg_content_length) {
+    if (!is_contiguous_mode(header, buffer)) {
+        return false;
+    }
+    const index_t capacity = header->capacity;
+    const index_t mask = capacity - 1;
+    uint64_t position = cursor->position;
+    //the records not consumed yet can't be more than capacity bytes: any further record is an already scanned one
+    while ((position - cursor->consumer_position) < (uint64_t) capacity) {
+        const index_t msg_index = position & mask;
+        const uint64_t msg_header = load_acquire_msg_header(buffer, msg_index);
+        const index_t msg_length = record_length(msg_header);
+        if (msg_length <= 0) {
+            break;
+        }
+        position += align(msg_length, RECORD_ALIGNMENT);
+        const uint32_t type_id = message_type_id(msg_header);
+        if (type_id != RECORD_PADDING_MSG_TYPE_ID) {
+            cursor->position = position;
+            *msg_type_id = type_id;
+            *msg_content_index = msg_index + RECORD_HEADER_LENGTH;
+            *msg_content_length = msg_length - RECORD_HEADER_LENGTH;
+            return true;
+        }
+    }
+    cursor->position = position;
+    return false;
+}
+
+inline static bool vs_rb_commit_scan(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                     struct vs_rb_cursor_t *const cursor, const uint64_t position) {
+    const uint64_t consumer_position = load_consumer_position(header, buffer);
+    //only the scanned records are known to be committed: any other could be still claimed or already zeroed
+    if (consumer_position != cursor->consumer_position || position < consumer_position ||
+        position > cursor->position) {
+        return false;
+    }
+    const index_t mask = header->capacity - 1;
+    //the scanned records are committed: walking them tells if the position is a record boundary
+    uint64_t record_position = consumer_position;
+    while (record_position < position) {
+        const uint64_t msg_header = load_acquire_msg_header(buffer, record_position & mask);
+        record_position += align(record_length(msg_header), RECORD_ALIGNMENT);
+    }
+    if (record_position != position) {
+        return false;
+    }
+    if (position != consumer_position) {
+        release_consumed_bytes(header, buffer, consumer_position, consumer_position & mask,
+                               (index_t) (position - consumer_position), VS_RB_ZEROING_TEMPORAL);
+        cursor->consumer_position = position;
+    }
+    return true;
+}
+
 inline static index_t vs_rb_size(const struct vs_rb_t *const header, const uint8_t *const buffer) {
     uint64_t previousConsumerPosition;
     uint64_t producerPosition;
@@ -389,4 +1026,6 @@ inline static index_t vs_rb_size(const struct vs_rb_t *const header, const uint8
     } while (consumerPosition != previousConsumerPosition);
     const index_t size = (producerPosition - consumerPosition);
     return size;
-}
\ No newline at end of file
+}
+
+#endif //FRANZ_FLOW_VS_RB_C
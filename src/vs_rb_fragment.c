@@ -0,0 +1,263 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_VS_RB_FRAGMENT_C
+#define FRANZ_FLOW_VS_RB_FRAGMENT_C
+
+#include <stdlib.h>
+#include <string.h>
+#include "vs_rb_fragment.h"
+#include "vs_rb.c"
+
+static const index_t FRAGMENT_HEADER_LENGTH = sizeof(struct vs_rb_fragment_header_t);
+
+static inline bool vs_rb_is_fragment(const uint32_t msg_type_id) {
+    return (msg_type_id & VS_RB_FRAGMENT_FLAG) != 0;
+}
+
+static inline bool is_unfragmented_msg_type_id(const uint32_t msg_type_id) {
+    return msg_type_id != 0 && msg_type_id <= VS_RB_FRAGMENT_MSG_TYPE_ID_MASK;
+}
+
+static inline bool new_vs_rb_fragmenter(struct vs_rb_fragmenter_t *const fragmenter,
+                                        const struct vs_rb_t *const header,
+                                        const uint32_t publisher_id, const index_t max_fragment_length) {
+    //a record that doesn't fit until the end of the buffer is preceded by a padding record shorter than it: with at most
+    //half of the capacity, a fragment always fits an empty ring buffer whatever is the producer index
+    const index_t max_allowed_fragment_length = (header->capacity / 2) - RECORD_HEADER_LENGTH - FRAGMENT_HEADER_LENGTH;
+    if (max_allowed_fragment_length <= 0 || max_fragment_length < 0 ||
+        max_fragment_length > max_allowed_fragment_length) {
+        return false;
+    }
+    fragmenter->message = NULL;
+    fragmenter->message_length = 0;
+    fragmenter->offset = 0;
+    fragmenter->fragment_index = 0;
+    fragmenter->msg_type_id = 0;
+    fragmenter->publisher_id = publisher_id;
+    fragmenter->max_fragment_length = max_fragment_length == 0 ? max_allowed_fragment_length : max_fragment_length;
+    return true;
+}
+
+static inline bool vs_rb_fragmenter_done(const struct vs_rb_fragmenter_t *const fragmenter) {
+    return fragmenter->message == NULL;
+}
+
+static inline bool vs_rb_fragmenter_begin(struct vs_rb_fragmenter_t *const fragmenter, const uint32_t msg_type_id,
+                                          const uint8_t *const message, const uint64_t message_length) {
+    if (!vs_rb_fragmenter_done(fragmenter) || !is_unfragmented_msg_type_id(msg_type_id)) {
+        return false;
+    }
+    fragmenter->message = message;
+    fragmenter->message_length = message_length;
+    fragmenter->offset = 0;
+    fragmenter->fragment_index = 0;
+    fragmenter->msg_type_id = msg_type_id;
+    return true;
+}
+
+static inline bool try_fragment(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                struct vs_rb_fragmenter_t *const fragmenter, const bool multi_producer) {
+    if (vs_rb_fragmenter_done(fragmenter)) {
+        return false;
+    }
+    const uint64_t remaining_bytes = fragmenter->message_length - fragmenter->offset;
+    const index_t fragment_length = remaining_bytes < (uint64_t) fragmenter->max_fragment_length ?
+                                    (index_t) remaining_bytes : fragmenter->max_fragment_length;
+    const index_t msg_content_length = FRAGMENT_HEADER_LENGTH + fragment_length;
+    uint64_t claimed_position;
+    index_t claimed_index;
+    const bool claimed = multi_producer ?
+                         vs_rb_try_mp_claim(header, buffer, msg_content_length, &claimed_position, &claimed_index) :
+                         vs_rb_try_sp_claim(header, buffer, msg_content_length, &claimed_position, &claimed_index);
+    if (!claimed) {
+        return false;
+    }
+    const struct vs_rb_fragment_header_t fragment_header = {
+            .publisher_id = fragmenter->publisher_id,
+            .fragment_index = fragmenter->fragment_index,
+            .message_length = fragmenter->message_length
+    };
+    uint8_t *const msg_content = buffer + vs_rb_encoded_msg_offset(claimed_index);
+    memcpy(msg_content, &fragment_header, FRAGMENT_HEADER_LENGTH);
+    memcpy(msg_content + FRAGMENT_HEADER_LENGTH, fragmenter->message + fragmenter->offset, fragment_length);
+    uint32_t flags = VS_RB_FRAGMENT_FLAG;
+    if (fragmenter->offset == 0) {
+        flags |= VS_RB_BEGIN_FRAGMENT_FLAG;
+    }
+    fragmenter->offset += fragment_length;
+    fragmenter->fragment_index++;
+    if (fragmenter->offset == fragmenter->message_length) {
+        flags |= VS_RB_END_FRAGMENT_FLAG;
+        fragmenter->message = NULL;
+    }
+    vs_rb_commit_claim(buffer, claimed_index, fragmenter->msg_type_id | flags, msg_content_length);
+    return true;
+}
+
+static inline bool vs_rb_try_sp_fragment(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                         struct vs_rb_fragmenter_t *const fragmenter) {
+    return try_fragment(header, buffer, fragmenter, false);
+}
+
+static inline bool vs_rb_try_mp_fragment(const struct vs_rb_t *const header, uint8_t *const buffer,
+                                         struct vs_rb_fragmenter_t *const fragmenter) {
+    return try_fragment(header, buffer, fragmenter, true);
+}
+
+static inline bool
+vs_rb_try_sp_offer_unfragmented(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t msg_type_id,
+                                const struct iovec *const segments, const uint32_t segments_count) {
+    return is_unfragmented_msg_type_id(msg_type_id) &&
+           vs_rb_try_sp_offer(header, buffer, msg_type_id, segments, segments_count);
+}
+
+static inline bool
+vs_rb_try_mp_offer_unfragmented(const struct vs_rb_t *const header, uint8_t *const buffer, const uint32_t msg_type_id,
+                                const struct iovec *const segments, const uint32_t segments_count) {
+    return is_unfragmented_msg_type_id(msg_type_id) &&
+           vs_rb_try_mp_offer(header, buffer, msg_type_id, segments, segments_count);
+}
+
+static inline bool vs_rb_commit_unfragmented_claim(const uint8_t *const buffer, const index_t msg_index,
+                                                   const uint32_t msg_type_id, const index_t msg_content_length) {
+    return is_unfragmented_msg_type_id(msg_type_id) &&
+           vs_rb_commit_claim(buffer, msg_index, msg_type_id, msg_content_length);
+}
+
+static inline bool new_vs_rb_reassembler(struct vs_rb_reassembler_t *const reassembler, const uint32_t publishers,
+                                         const uint32_t pool_buffers, const uint64_t max_message_length) {
+    if (publishers == 0 || pool_buffers == 0) {
+        return false;
+    }
+    reassembler->reassemblies = calloc(publishers, sizeof(struct vs_rb_reassembly_t));
+    //the buffers are allocated on first use
+    reassembler->pool = calloc(pool_buffers, sizeof(struct vs_rb_pool_buffer_t));
+    reassembler->free_buffers = calloc(pool_buffers, sizeof(struct vs_rb_pool_buffer_t *));
+    if (reassembler->reassemblies == NULL || reassembler->pool == NULL || reassembler->free_buffers == NULL) {
+        vs_rb_reassembler_free(reassembler);
+        return false;
+    }
+    for (uint32_t i = 0; i < pool_buffers; i++) {
+        reassembler->free_buffers[i] = &reassembler->pool[i];
+    }
+    reassembler->free_buffers_count = pool_buffers;
+    reassembler->pool_buffers = pool_buffers;
+    reassembler->publishers = publishers;
+    reassembler->max_message_length = max_message_length;
+    reassembler->dropped_messages = 0;
+    return true;
+}
+
+static inline void vs_rb_reassembler_free(struct vs_rb_reassembler_t *const reassembler) {
+    if (reassembler->pool != NULL) {
+        for (uint32_t i = 0; i < reassembler->pool_buffers; i++) {
+            free(reassembler->pool[i].bytes);
+        }
+    }
+    free(reassembler->pool);
+    free(reassembler->free_buffers);
+    free(reassembler->reassemblies);
+    reassembler->pool = NULL;
+    reassembler->free_buffers = NULL;
+    reassembler->reassemblies = NULL;
+    reassembler->pool_buffers = 0;
+    reassembler->free_buffers_count = 0;
+}
+
+static inline struct vs_rb_pool_buffer_t *
+acquire_pool_buffer(struct vs_rb_reassembler_t *const reassembler, const uint64_t length) {
+    if (reassembler->free_buffers_count == 0) {
+        return NULL;
+    }
+    struct vs_rb_pool_buffer_t *const pool_buffer = reassembler->free_buffers[reassembler->free_buffers_count - 1];
+    if (pool_buffer->capacity < length) {
+        uint8_t *const bytes = realloc(pool_buffer->bytes, length);
+        if (bytes == NULL) {
+            return NULL;
+        }
+        pool_buffer->bytes = bytes;
+        pool_buffer->capacity = length;
+    }
+    reassembler->free_buffers_count--;
+    return pool_buffer;
+}
+
+static inline void release_reassembly(struct vs_rb_reassembler_t *const reassembler,
+                                      struct vs_rb_reassembly_t *const reassembly) {
+    reassembler->free_buffers[reassembler->free_buffers_count] = reassembly->buffer;
+    reassembler->free_buffers_count++;
+    reassembly->buffer = NULL;
+}
+
+static inline void drop_reassembly(struct vs_rb_reassembler_t *const reassembler,
+                                   struct vs_rb_reassembly_t *const reassembly) {
+    if (reassembly->buffer != NULL) {
+        release_reassembly(reassembler, reassembly);
+    }
+    reassembler->dropped_messages++;
+}
+
+static inline bool vs_rb_reassembler_on_fragment(struct vs_rb_reassembler_t *const reassembler,
+                                                 const uint32_t msg_type_id, const uint8_t *const buffer,
+                                                 const index_t msg_content_index, const index_t msg_content_length,
+                                                 const vs_rb_reassembled_consumer consumer, void *const context) {
+    if (msg_content_length < FRAGMENT_HEADER_LENGTH) {
+        reassembler->dropped_messages++;
+        return true;
+    }
+    struct vs_rb_fragment_header_t fragment_header;
+    memcpy(&fragment_header, buffer + msg_content_index, FRAGMENT_HEADER_LENGTH);
+    if (fragment_header.publisher_id >= reassembler->publishers) {
+        reassembler->dropped_messages++;
+        return true;
+    }
+    struct vs_rb_reassembly_t *const reassembly = &reassembler->reassemblies[fragment_header.publisher_id];
+    if ((msg_type_id & VS_RB_BEGIN_FRAGMENT_FLAG) != 0) {
+        if (reassembly->buffer != NULL) {
+            //the previous message of the publisher has never been completed
+            drop_reassembly(reassembler, reassembly);
+        }
+        if (fragment_header.message_length > reassembler->max_message_length) {
+            reassembler->dropped_messages++;
+            return true;
+        }
+        reassembly->buffer = acquire_pool_buffer(reassembler, fragment_header.message_length);
+        if (reassembly->buffer == NULL) {
+            reassembler->dropped_messages++;
+            return true;
+        }
+        reassembly->message_length = fragment_header.message_length;
+        reassembly->received = 0;
+        reassembly->next_fragment_index = 0;
+        reassembly->msg_type_id = msg_type_id & VS_RB_FRAGMENT_MSG_TYPE_ID_MASK;
+    } else if (reassembly->buffer == NULL) {
+        //the begin of the message has been dropped: it is already accounted
+        return true;
+    }
+    const index_t fragment_length = msg_content_length - FRAGMENT_HEADER_LENGTH;
+    if (fragment_header.fragment_index != reassembly->next_fragment_index ||
+        fragment_header.message_length != reassembly->message_length ||
+        reassembly->received + fragment_length > reassembly->message_length) {
+        drop_reassembly(reassembler, reassembly);
+        return true;
+    }
+    memcpy(reassembly->buffer->bytes + reassembly->received,
+           buffer + msg_content_index + FRAGMENT_HEADER_LENGTH, fragment_length);
+    reassembly->received += fragment_length;
+    reassembly->next_fragment_index++;
+    if ((msg_type_id & VS_RB_END_FRAGMENT_FLAG) == 0) {
+        return true;
+    }
+    if (reassembly->received != reassembly->message_length) {
+        drop_reassembly(reassembler, reassembly);
+        return true;
+    }
+    const bool continue_reading = consumer(reassembly->msg_type_id, reassembly->buffer->bytes,
+                                           reassembly->message_length, context);
+    release_reassembly(reassembler, reassembly);
+    return continue_reading;
+}
+
+#endif //FRANZ_FLOW_VS_RB_FRAGMENT_C
@@ -0,0 +1,172 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_VS_RB_LANES_C
+#define FRANZ_FLOW_VS_RB_LANES_C
+
+#include "vs_rb_lanes.h"
+#include "vs_rb.c"
+
+/**
+ * It wraps the consumer of a {@code vs_rb_lanes_read} to distinguish a drained lane from a stop of the consumer.
+ */
+struct lanes_read_context {
+    vs_rb_message_consumer consumer;
+    void *context;
+    bool stopped;
+};
+
+inline static index_t vs_rb_lanes_capacity(const struct vs_rb_lane_config_t *const configs, const uint32_t count) {
+    index_t capacity = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        capacity += vs_rb_capacity(configs[i].requested_capacity);
+    }
+    return capacity;
+}
+
+inline static bool new_vs_rb_lanes(struct vs_rb_lanes_t *const lanes, uint8_t *const buffer,
+                                   const struct vs_rb_lane_config_t *const configs, const uint32_t count,
+                                   const enum vs_rb_lanes_policy policy) {
+    if (count == 0 || count > VS_RB_MAX_LANES) {
+        return false;
+    }
+    //each lane length is a power of 2 plus a trailer of whole cache lines: the next lane is still aligned
+    index_t lane_offset = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const struct vs_rb_lane_config_t *const config = &configs[i];
+        struct vs_rb_lane_t *const lane = &lanes->lanes[i];
+        const index_t lane_length = vs_rb_capacity(config->requested_capacity);
+        if (config->batch_limit == 0 || (policy == VS_RB_LANES_WEIGHTED_ROUND_ROBIN && config->weight == 0) ||
+            !new_vs_rb(&lane->header, lane_length)) {
+            return false;
+        }
+        lane->buffer = buffer + lane_offset;
+        lane->weight = config->weight;
+        lane->batch_limit = config->batch_limit;
+        lane_offset += lane_length;
+    }
+    lanes->count = count;
+    lanes->policy = policy;
+    lanes->reading_lane = 0;
+    lanes->next_lane = 0;
+    lanes->credits = lanes->lanes[0].weight;
+    return true;
+}
+
+inline static const struct vs_rb_t *vs_rb_lanes_header(const struct vs_rb_lanes_t *const lanes, const uint32_t lane) {
+    return &lanes->lanes[lane].header;
+}
+
+inline static uint8_t *vs_rb_lanes_buffer(const struct vs_rb_lanes_t *const lanes, const uint32_t lane) {
+    return lanes->lanes[lane].buffer;
+}
+
+inline static bool
+vs_rb_lanes_try_sp_offer(const struct vs_rb_lanes_t *const lanes, const uint32_t lane, const uint32_t msg_type_id,
+                         const struct iovec *const segments, const uint32_t segments_count) {
+    if (lane >= lanes->count) {
+        return false;
+    }
+    const struct vs_rb_lane_t *const target = &lanes->lanes[lane];
+    return vs_rb_try_sp_offer(&target->header, target->buffer, msg_type_id, segments, segments_count);
+}
+
+inline static bool
+vs_rb_lanes_try_mp_offer(const struct vs_rb_lanes_t *const lanes, const uint32_t lane, const uint32_t msg_type_id,
+                         const struct iovec *const segments, const uint32_t segments_count) {
+    if (lane >= lanes->count) {
+        return false;
+    }
+    const struct vs_rb_lane_t *const target = &lanes->lanes[lane];
+    return vs_rb_try_mp_offer(&target->header, target->buffer, msg_type_id, segments, segments_count);
+}
+
+inline static bool is_lane_idle(const struct vs_rb_lane_t *const lane) {
+    //the consumer position and the record header on it are the only lines touched: the producer ones aren't
+    const uint64_t consumer_position = load_consumer_position(&lane->header, lane->buffer);
+    const index_t consumer_index = consumer_position & (lane->header.capacity - 1);
+    const uint64_t msg_header = load_acquire_msg_header(lane->buffer, consumer_index);
+    return record_length(msg_header) <= 0;
+}
+
+inline static bool lanes_read_consumer(const uint32_t msg_type_id, const uint8_t *const buffer,
+                                       const index_t msg_content_index, const index_t msg_content_length,
+                                       void *const context) {
+    struct lanes_read_context *const read_context = (struct lanes_read_context *) context;
+    const bool continue_reading = read_context->consumer(msg_type_id, buffer, msg_content_index, msg_content_length,
+                                                         read_context->context);
+    read_context->stopped = !continue_reading;
+    return continue_reading;
+}
+
+inline static uint32_t read_lane(struct vs_rb_lanes_t *const lanes, const uint32_t lane, const uint32_t count,
+                                 struct lanes_read_context *const read_context) {
+    struct vs_rb_lane_t *const target = &lanes->lanes[lane];
+    lanes->reading_lane = lane;
+    return vs_rb_read(&target->header, target->buffer, lanes_read_consumer, count, read_context);
+}
+
+inline static uint32_t min_u32(const uint32_t a, const uint32_t b) {
+    return a < b ? a : b;
+}
+
+inline static uint32_t strict_priority_read(struct vs_rb_lanes_t *const lanes, const uint32_t count,
+                                            struct lanes_read_context *const read_context) {
+    uint32_t msg_read = 0;
+    uint32_t lane = 0;
+    while (lane < lanes->count && msg_read < count && !read_context->stopped) {
+        if (is_lane_idle(&lanes->lanes[lane])) {
+            lane++;
+            continue;
+        }
+        const uint32_t batch = min_u32(lanes->lanes[lane].batch_limit, count - msg_read);
+        const uint32_t lane_read = read_lane(lanes, lane, batch, read_context);
+        msg_read += lane_read;
+        //after each batch the more important lanes are checked again
+        lane = lane_read != 0 ? 0 : lane + 1;
+    }
+    return msg_read;
+}
+
+inline static void next_round_robin_lane(struct vs_rb_lanes_t *const lanes) {
+    const uint32_t next_lane = lanes->next_lane + 1;
+    lanes->next_lane = next_lane == lanes->count ? 0 : next_lane;
+    lanes->credits = lanes->lanes[lanes->next_lane].weight;
+}
+
+inline static uint32_t weighted_round_robin_read(struct vs_rb_lanes_t *const lanes, const uint32_t count,
+                                                 struct lanes_read_context *const read_context) {
+    uint32_t msg_read = 0;
+    //the lanes visited in a row without reading anything: when all of them are, there is nothing to read
+    uint32_t idle_lanes = 0;
+    while (idle_lanes < lanes->count && msg_read < count && !read_context->stopped) {
+        const uint32_t lane = lanes->next_lane;
+        if (is_lane_idle(&lanes->lanes[lane])) {
+            idle_lanes++;
+            next_round_robin_lane(lanes);
+            continue;
+        }
+        const uint32_t batch = min_u32(min_u32(lanes->lanes[lane].batch_limit, lanes->credits), count - msg_read);
+        const uint32_t lane_read = read_lane(lanes, lane, batch, read_context);
+        msg_read += lane_read;
+        lanes->credits -= lane_read;
+        idle_lanes = lane_read != 0 ? 0 : idle_lanes + 1;
+        //a lane keeps its turn until it uses all its credits or is drained
+        if (lanes->credits == 0 || (lane_read < batch && !read_context->stopped)) {
+            next_round_robin_lane(lanes);
+        }
+    }
+    return msg_read;
+}
+
+inline static uint32_t vs_rb_lanes_read(struct vs_rb_lanes_t *const lanes, const vs_rb_message_consumer consumer,
+                                        const uint32_t count, void *const context) {
+    struct lanes_read_context read_context = {.consumer = consumer, .context = context, .stopped = false};
+    if (lanes->policy == VS_RB_LANES_STRICT_PRIORITY) {
+        return strict_priority_read(lanes, count, &read_context);
+    }
+    return weighted_round_robin_read(lanes, count, &read_context);
+}
+
+#endif //FRANZ_FLOW_VS_RB_LANES_C
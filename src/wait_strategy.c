@@ -0,0 +1,151 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_WAIT_STRATEGY_C
+#define FRANZ_FLOW_WAIT_STRATEGY_C
+
+#include <stdatomic.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "wait_strategy.h"
+
+/**
+ * The park word holds the count of the parked waiters on the lowest 16 bits and an unpark sequence on the others:
+ * several waiters can share the same park word.
+ */
+static const uint32_t PARKED_WAITERS_MASK = 0xFFFF;
+static const uint32_t PARKED_WAITER_INCREMENT = 1;
+static const uint32_t UNPARK_SEQUENCE_INCREMENT = PARKED_WAITERS_MASK + 1;
+static const uint64_t MIN_PARK_NANOS = 1000;
+static const uint32_t MAX_PARK_SHIFT = 20;
+
+static inline void new_busy_spin_wait_strategy(struct wait_strategy_t *const strategy) {
+    strategy->type = BUSY_SPIN_WAIT;
+    strategy->max_spins = 0;
+    strategy->max_yields = 0;
+    strategy->max_park_nanos = 0;
+    strategy->park_word = NULL;
+    strategy->is_ready = NULL;
+    strategy->context = NULL;
+}
+
+static inline void new_yield_wait_strategy(struct wait_strategy_t *const strategy) {
+    new_busy_spin_wait_strategy(strategy);
+    strategy->type = YIELD_WAIT;
+}
+
+static inline bool new_backoff_wait_strategy(struct wait_strategy_t *const strategy,
+                                             const uint32_t max_spins,
+                                             const uint32_t max_yields,
+                                             const uint64_t max_park_nanos) {
+    if (max_park_nanos == 0) {
+        return false;
+    }
+    new_busy_spin_wait_strategy(strategy);
+    strategy->type = BACKOFF_WAIT;
+    strategy->max_spins = max_spins;
+    strategy->max_yields = max_yields;
+    strategy->max_park_nanos = max_park_nanos;
+    return true;
+}
+
+static inline bool new_park_wait_strategy(struct wait_strategy_t *const strategy,
+                                          const uint32_t max_spins,
+                                          const uint32_t max_yields,
+                                          const uint64_t max_park_nanos,
+                                          _Atomic uint32_t *const park_word,
+                                          const wait_condition is_ready,
+                                          void *const context) {
+    if (!new_backoff_wait_strategy(strategy, max_spins, max_yields, max_park_nanos)) {
+        return false;
+    }
+    strategy->type = PARK_WAIT;
+    strategy->park_word = park_word;
+    strategy->is_ready = is_ready;
+    strategy->context = context;
+    return true;
+}
+
+static inline void nanos_to_timespec(const uint64_t nanos, struct timespec *const time) {
+    time->tv_sec = nanos / 1000000000;
+    time->tv_nsec = nanos % 1000000000;
+}
+
+static inline uint64_t park_nanos(const struct wait_strategy_t *const strategy, const uint32_t park_count) {
+    const uint32_t shift = park_count < MAX_PARK_SHIFT ? park_count : MAX_PARK_SHIFT;
+    const uint64_t nanos = MIN_PARK_NANOS << shift;
+    return nanos < strategy->max_park_nanos ? nanos : strategy->max_park_nanos;
+}
+
+static void park(const struct wait_strategy_t *const strategy, const uint64_t nanos) {
+    _Atomic uint32_t *const park_word = strategy->park_word;
+    //announce the park: any producer that will commit after it will unpark this waiter
+    const uint32_t parked_word = atomic_fetch_add_explicit(park_word, PARKED_WAITER_INCREMENT, memory_order_seq_cst) +
+                                 PARKED_WAITER_INCREMENT;
+    //StoreLoad: pairs with the fence in wait_strategy_unpark, hence the producer will see the parked waiter or
+    //this waiter will see what the producer has committed
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!strategy->is_ready(strategy->context)) {
+        struct timespec timeout;
+        nanos_to_timespec(nanos, &timeout);
+        //if any producer has unparked it in the meantime the word is changed and it returns immediately
+        syscall(SYS_futex, park_word, FUTEX_WAIT, parked_word, &timeout, NULL, 0);
+    }
+    //an unpark has already removed all the waiters counted with the same sequence: on timeout/ready remove just this
+    //one, to avoid producers to perform useless syscalls, leaving the others parked to be woken up
+    uint32_t word = atomic_load_explicit(park_word, memory_order_relaxed);
+    while ((word & ~PARKED_WAITERS_MASK) == (parked_word & ~PARKED_WAITERS_MASK) &&
+           !atomic_compare_exchange_weak_explicit(park_word, &word, word - PARKED_WAITER_INCREMENT,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static inline uint32_t wait_strategy_idle(const struct wait_strategy_t *const strategy, const uint32_t idle_count) {
+    const enum wait_strategy_type type = strategy->type;
+    if (type == BUSY_SPIN_WAIT) {
+        __asm__ __volatile__("pause;");
+    } else if (type == YIELD_WAIT) {
+        sched_yield();
+    } else {
+        const uint32_t max_spins = strategy->max_spins;
+        const uint32_t max_yields = strategy->max_yields;
+        if (idle_count < max_spins) {
+            __asm__ __volatile__("pause;");
+        } else if (idle_count < (max_spins + max_yields)) {
+            sched_yield();
+        } else {
+            const uint64_t nanos = park_nanos(strategy, idle_count - (max_spins + max_yields));
+            if (type == PARK_WAIT) {
+                park(strategy, nanos);
+            } else {
+                struct timespec sleep_time;
+                nanos_to_timespec(nanos, &sleep_time);
+                nanosleep(&sleep_time, NULL);
+            }
+        }
+    }
+    return idle_count == UINT32_MAX ? idle_count : idle_count + 1;
+}
+
+static inline void wait_strategy_unpark(_Atomic uint32_t *const park_word) {
+    //StoreLoad: the commit of the message must happen before checking if any waiter is parked
+    atomic_thread_fence(memory_order_seq_cst);
+    uint32_t word = atomic_load_explicit(park_word, memory_order_relaxed);
+    //the common case: nobody is parked and no syscalls are needed
+    while ((word & PARKED_WAITERS_MASK) != 0) {
+        //clear the waiters and change the sequence, making fail any park that is about to sleep: a failure means
+        //that a waiter has come or gone, or another producer has already unparked all of them
+        const uint32_t unparked_word = (word + UNPARK_SEQUENCE_INCREMENT) & ~PARKED_WAITERS_MASK;
+        if (atomic_compare_exchange_weak_explicit(park_word, &word, unparked_word, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            syscall(SYS_futex, park_word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+            return;
+        }
+    }
+}
+
+#endif //FRANZ_FLOW_WAIT_STRATEGY_C
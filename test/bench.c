@@ -0,0 +1,184 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_BENCH_C
+#define FRANZ_FLOW_BENCH_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "bench.h"
+#include "histogram.c"
+#include "wait_strategy.c"
+#include "rb_alloc.c"
+
+static inline uint64_t bench_nanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+inline static bool bench_new_wait_strategy(const enum wait_strategy_type type, const bool consumer,
+                                           struct wait_strategy_t *const wait_strategy) {
+    switch (type) {
+        case YIELD_WAIT:
+            new_yield_wait_strategy(wait_strategy);
+            return true;
+        case BACKOFF_WAIT:
+            return new_backoff_wait_strategy(wait_strategy, 100, 10, 1000000);
+        case PARK_WAIT:
+            //only the consumers have a park word: the producers of a full queue back off
+            if (!consumer) {
+                return new_backoff_wait_strategy(wait_strategy, 100, 10, 1000000);
+            }
+            //the park word and the condition are set by each queue consumer with bench_park_consumer
+            return new_park_wait_strategy(wait_strategy, 100, 10, 1000000, NULL, NULL, NULL);
+        default:
+            new_busy_spin_wait_strategy(wait_strategy);
+            return true;
+    }
+}
+
+static inline void bench_park_consumer(struct bench_thread *const thread, _Atomic uint32_t *const park_word,
+                                       const wait_condition is_ready, void *const context) {
+    if (thread->wait_strategy.type == PARK_WAIT) {
+        thread->wait_strategy.park_word = park_word;
+        thread->wait_strategy.is_ready = is_ready;
+        thread->wait_strategy.context = context;
+    }
+}
+
+static inline void bench_unpark_consumers(const struct bench_options *const options,
+                                          _Atomic uint32_t *const park_word) {
+    //the other strategies don't pay the StoreLoad fence of the unpark
+    if (options->wait == PARK_WAIT) {
+        wait_strategy_unpark(park_word);
+    }
+}
+
+static inline bool bench_pin_current_thread(const int cpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus) == 0;
+}
+
+inline static void *bench_thread_main(void *arg) {
+    struct bench_thread *const thread = (struct bench_thread *) arg;
+    if (thread->cpu >= 0) {
+        bench_pin_current_thread(thread->cpu);
+    }
+    pthread_barrier_wait(thread->start);
+    return thread->function(thread);
+}
+
+static inline bool bench_run_threads(const struct bench_options *const options, void *const queue,
+                                     const bench_thread_function producer, const bench_thread_function consumer,
+                                     struct bench_run *const run) {
+    const uint32_t consumers = options->consumers;
+    const uint32_t threads = consumers + options->producers;
+    if (threads > BENCH_MAX_THREADS) {
+        return false;
+    }
+    //each thread holds its own histogram: better on the heap
+    struct bench_thread *const bench_threads = calloc(threads, sizeof(struct bench_thread));
+    if (bench_threads == NULL) {
+        return false;
+    }
+    pthread_t thread_ids[BENCH_MAX_THREADS];
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, threads + 1);
+    for (uint32_t i = 0; i < threads; i++) {
+        struct bench_thread *const thread = &bench_threads[i];
+        thread->options = options;
+        thread->queue = queue;
+        thread->id = i < consumers ? i : i - consumers;
+        thread->cpu = i < options->cpus_count ? options->cpus[i] : -1;
+        thread->start = &start;
+        thread->function = i < consumers ? consumer : producer;
+        if (!bench_new_wait_strategy(options->wait, i < consumers, &thread->wait_strategy)) {
+            pthread_barrier_destroy(&start);
+            free(bench_threads);
+            return false;
+        }
+        new_histogram(&thread->latency);
+    }
+    for (uint32_t i = 0; i < threads; i++) {
+        pthread_create(&thread_ids[i], NULL, bench_thread_main, &bench_threads[i]);
+    }
+    pthread_barrier_wait(&start);
+    const uint64_t start_nanos = bench_nanos();
+    for (uint32_t i = 0; i < threads; i++) {
+        pthread_join(thread_ids[i], NULL);
+    }
+    run->elapsed_nanos = bench_nanos() - start_nanos;
+    run->messages = 0;
+    run->failed_claims = 0;
+    run->failed_reads = 0;
+    new_histogram(&run->latency);
+    for (uint32_t i = 0; i < threads; i++) {
+        const struct bench_thread *const thread = &bench_threads[i];
+        if (i < consumers) {
+            run->messages += thread->consumed;
+            run->failed_reads += thread->failed;
+            histogram_add(&run->latency, &thread->latency);
+        } else {
+            run->failed_claims += thread->failed;
+        }
+    }
+    pthread_barrier_destroy(&start);
+    free(bench_threads);
+    return true;
+}
+
+static inline bool bench_alloc(const struct bench_options *const options, const index_t length,
+                               struct rb_alloc_t *const alloc) {
+    const int flags = RB_ALLOC_PREFAULT | (options->huge_pages ? RB_ALLOC_HUGE_PAGES : 0);
+    return rb_alloc(length, options->numa_node, flags, alloc);
+}
+
+static inline uint8_t *bench_new_payload(const struct bench_options *const options) {
+    uint8_t *const payload = malloc(options->message_size);
+    for (uint32_t i = 0; i < options->message_size; i++) {
+        payload[i] = (uint8_t) i;
+    }
+    return payload;
+}
+
+static inline uint32_t bench_slot_size(const struct bench_options *const options) {
+    return options->payload == BENCH_POINTER_PAYLOAD ? sizeof(uint8_t *) : options->message_size;
+}
+
+static inline void bench_write_message(const struct bench_options *const options, uint8_t *const slot,
+                                       const uint8_t *const payload) {
+    const uint64_t send_nanos = bench_nanos();
+    //slots could be just 4 bytes aligned: memcpy avoids unaligned accesses
+    if (options->payload == BENCH_POINTER_PAYLOAD) {
+        uint8_t *const message = malloc(options->message_size);
+        memcpy(message, payload, options->message_size);
+        memcpy(message, &send_nanos, sizeof(send_nanos));
+        memcpy(slot, &message, sizeof(message));
+    } else {
+        memcpy(slot, payload, options->message_size);
+        memcpy(slot, &send_nanos, sizeof(send_nanos));
+    }
+}
+
+static inline void bench_read_message(struct bench_thread *const thread, const uint8_t *const slot) {
+    uint64_t send_nanos;
+    if (thread->options->payload == BENCH_POINTER_PAYLOAD) {
+        uint8_t *message;
+        memcpy(&message, slot, sizeof(message));
+        memcpy(&send_nanos, message, sizeof(send_nanos));
+        //free it in the consumer thread
+        free(message);
+    } else {
+        memcpy(&send_nanos, slot, sizeof(send_nanos));
+    }
+    histogram_record(&thread->latency, bench_nanos() - send_nanos);
+    thread->consumed++;
+}
+
+#endif //FRANZ_FLOW_BENCH_C
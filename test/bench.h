@@ -0,0 +1,143 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_BENCH_H
+#define FRANZ_FLOW_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "histogram.h"
+#include "wait_strategy.h"
+#include "rb_alloc.h"
+
+#define BENCH_MAX_THREADS 64
+
+enum bench_payload {
+    BENCH_COPY_PAYLOAD,                 /*  the message is copied into the claimed slot                             */
+    BENCH_POINTER_PAYLOAD               /*  a malloc'd message is passed by pointer and freed by the consumer       */
+};
+
+enum bench_format {
+    BENCH_TEXT_FORMAT,
+    BENCH_CSV_FORMAT,
+    BENCH_JSON_FORMAT
+};
+
+struct bench_options {
+    const char *queue;                  /*  vs_rb, fs_rb, fs_mpmc_rb or fs_stream                                   */
+    uint32_t producers;
+    uint32_t consumers;
+    uint32_t message_size;              /*  bytes of each message: at least 8, to hold the send timestamp           */
+    uint32_t capacity;                  /*  max number of messages the queue can hold                               */
+    uint32_t batch;                     /*  max number of messages read by each consumer read                       */
+    uint64_t messages;                  /*  messages sent by each producer on each run                              */
+    uint32_t runs;
+    uint32_t cpus_count;                /*  0 to not pin any thread                                                 */
+    int cpus[BENCH_MAX_THREADS];        /*  pinned in order: consumers first, then producers                        */
+    int numa_node;                      /*  the NUMA node of the queue memory, RB_ALLOC_ANY_NUMA_NODE by default    */
+    bool huge_pages;                    /*  back the queue memory with 2MB pages                                    */
+    enum wait_strategy_type wait;
+    enum bench_payload payload;
+    enum bench_format format;
+};
+
+/**
+ * The results of a single benchmark run.
+ */
+struct bench_run {
+    uint64_t elapsed_nanos;             /*  wall clock time from the start of the producers to the last consumed    */
+    uint64_t messages;                  /*  total messages consumed                                                 */
+    uint64_t failed_claims;             /*  total failed claims of the producers                                    */
+    uint64_t failed_reads;              /*  total empty reads of the consumers                                      */
+    struct histogram_t latency;         /*  nanoseconds from the claim of a message to its consume                  */
+};
+
+/**
+ * The state of a benchmark thread, owned by it while running.
+ */
+struct bench_thread {
+    const struct bench_options *options;
+    void *queue;                        /*  the queue specific state, shared by all the threads                     */
+    uint32_t id;                        /*  the producer/consumer id                                                */
+    int cpu;                            /*  -1 if not pinned                                                        */
+    pthread_barrier_t *start;
+    void *(*function)(void *);          /*  the producer/consumer loop                                              */
+    struct wait_strategy_t wait_strategy;
+    uint64_t failed;                    /*  failed claims for producers, empty reads for consumers                  */
+    uint64_t consumed;
+    struct histogram_t latency;
+};
+
+typedef void *(*bench_thread_function)(void *);
+
+/**
+ * Each queue benchmark runs a single run of the given options and fills {@code run}.
+ *
+ * @returns {@code false} if the options aren't supported by the queue
+ */
+bool bench_vs_rb_run(const struct bench_options *const options, struct bench_run *const run);
+
+bool bench_fs_rb_run(const struct bench_options *const options, struct bench_run *const run);
+
+bool bench_fs_mpmc_rb_run(const struct bench_options *const options, struct bench_run *const run);
+
+bool bench_fs_stream_run(const struct bench_options *const options, struct bench_run *const run);
+
+static inline uint64_t bench_nanos(void);
+
+/**
+ * @returns {@code true} if the calling thread has been pinned to the given cpu, {@code false} otherwise
+ */
+static inline bool bench_pin_current_thread(const int cpu);
+
+/**
+ * Start the producers and consumers threads pinned as configured, wait until all of them are completed and collect
+ * their results into {@code run}.
+ */
+static inline bool bench_run_threads(const struct bench_options *const options, void *const queue,
+                                     const bench_thread_function producer, const bench_thread_function consumer,
+                                     struct bench_run *const run);
+
+/**
+ * With {@code PARK_WAIT}, set the word on which the consumer sleeps and the condition to not sleep: to be called by
+ * each consumer before its first read.
+ */
+static inline void bench_park_consumer(struct bench_thread *const thread, _Atomic uint32_t *const park_word,
+                                       const wait_condition is_ready, void *const context);
+
+/**
+ * With {@code PARK_WAIT}, wake up the consumers parked on {@code park_word}: to be called after each commit.
+ */
+static inline void bench_unpark_consumers(const struct bench_options *const options,
+                                          _Atomic uint32_t *const park_word);
+
+/**
+ * Allocate the prefaulted and zeroed queue memory as configured by the options.
+ */
+static inline bool bench_alloc(const struct bench_options *const options, const index_t length,
+                               struct rb_alloc_t *const alloc);
+
+/**
+ * A message payload to be copied on each send, to be released with {@code free}.
+ */
+static inline uint8_t *bench_new_payload(const struct bench_options *const options);
+
+/**
+ * The slot size in bytes needed by each message in the queue.
+ */
+static inline uint32_t bench_slot_size(const struct bench_options *const options);
+
+/**
+ * Write a message in the claimed slot, stamped with the current time.
+ */
+static inline void bench_write_message(const struct bench_options *const options, uint8_t *const slot,
+                                       const uint8_t *const payload);
+
+/**
+ * Consume a message from its slot, recording its latency.
+ */
+static inline void bench_read_message(struct bench_thread *const thread, const uint8_t *const slot);
+
+#endif //FRANZ_FLOW_BENCH_H
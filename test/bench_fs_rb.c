@@ -0,0 +1,163 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "bench.h"
+#include "bench.c"
+#include "fs_rb.h"
+#include "fs_rb.c"
+#include "fs_mpmc_rb.h"
+#include "fs_mpmc_rb.c"
+
+struct bench_fs_rb {
+    struct fs_rb_t header;
+    uint8_t *buffer;
+    struct rb_alloc_t alloc;
+    uint32_t max_look_ahead_step;
+    _Atomic uint64_t consumed;          /*  fs_mpmc_rb only: messages consumed by all the consumers                 */
+};
+
+static void *bench_fs_rb_producer(void *arg) {
+    struct bench_thread *const thread = (struct bench_thread *) arg;
+    const struct bench_options *const options = thread->options;
+    struct bench_fs_rb *const queue = (struct bench_fs_rb *) thread->queue;
+    uint8_t *const buffer = queue->buffer;
+    uint8_t *const payload = bench_new_payload(options);
+    uint8_t *claimed_message;
+    for (uint64_t m = 0; m < options->messages; m++) {
+        uint32_t idle_count = 0;
+        if (options->producers == 1) {
+            while (!try_fs_rb_sp_claim(buffer, &queue->header, queue->max_look_ahead_step, &claimed_message)) {
+                idle_count = wait_strategy_idle(&thread->wait_strategy, idle_count);
+                thread->failed++;
+            }
+        } else {
+            while (!try_fs_rb_mp_claim(buffer, &queue->header, &claimed_message)) {
+                idle_count = wait_strategy_idle(&thread->wait_strategy, idle_count);
+                thread->failed++;
+            }
+        }
+        bench_write_message(options, claimed_message, payload);
+        fs_rb_commit_claim(claimed_message);
+        bench_unpark_consumers(options, fs_rb_consumer_park_word(&queue->header));
+    }
+    free(payload);
+    return NULL;
+}
+
+static bool bench_fs_rb_on_message(uint8_t *const message, void *const context) {
+    bench_read_message((struct bench_thread *) context, message);
+    return true;
+}
+
+static bool bench_fs_rb_is_ready(void *const context) {
+    const struct bench_fs_rb *const queue = (const struct bench_fs_rb *) context;
+    return fs_rb_size(&queue->header) != 0;
+}
+
+static void *bench_fs_rb_consumer(void *arg) {
+    struct bench_thread *const thread = (struct bench_thread *) arg;
+    const struct bench_options *const options = thread->options;
+    struct bench_fs_rb *const queue = (struct bench_fs_rb *) thread->queue;
+    const uint64_t total_messages = options->producers * options->messages;
+    uint32_t idle_count = 0;
+    bench_park_consumer(thread, fs_rb_consumer_park_word(&queue->header), &bench_fs_rb_is_ready, queue);
+    while (thread->consumed < total_messages) {
+        if (fs_rb_read(queue->buffer, &queue->header, &bench_fs_rb_on_message, options->batch, thread) == 0) {
+            idle_count = wait_strategy_idle(&thread->wait_strategy, idle_count);
+            thread->failed++;
+        } else {
+            idle_count = 0;
+        }
+    }
+    return NULL;
+}
+
+static void *bench_fs_mpmc_rb_producer(void *arg) {
+    struct bench_thread *const thread = (struct bench_thread *) arg;
+    const struct bench_options *const options = thread->options;
+    struct bench_fs_rb *const queue = (struct bench_fs_rb *) thread->queue;
+    uint8_t *const buffer = queue->buffer;
+    uint8_t *const payload = bench_new_payload(options);
+    uint8_t *claimed_message;
+    for (uint64_t m = 0; m < options->messages; m++) {
+        uint32_t idle_count = 0;
+        while (!try_fs_mpmc_rb_claim(buffer, &queue->header, &claimed_message)) {
+            idle_count = wait_strategy_idle(&thread->wait_strategy, idle_count);
+            thread->failed++;
+        }
+        bench_write_message(options, claimed_message, payload);
+        fs_mpmc_rb_commit_claim(claimed_message);
+        bench_unpark_consumers(options, fs_rb_consumer_park_word(&queue->header));
+    }
+    free(payload);
+    return NULL;
+}
+
+static void *bench_fs_mpmc_rb_consumer(void *arg) {
+    struct bench_thread *const thread = (struct bench_thread *) arg;
+    const struct bench_options *const options = thread->options;
+    struct bench_fs_rb *const queue = (struct bench_fs_rb *) thread->queue;
+    const uint64_t total_messages = options->producers * options->messages;
+    uint32_t idle_count = 0;
+    //the fs_mpmc_rb consumers share the same park word
+    bench_park_consumer(thread, fs_rb_consumer_park_word(&queue->header), &bench_fs_rb_is_ready, queue);
+    while (atomic_load_explicit(&queue->consumed, memory_order_relaxed) < total_messages) {
+        const uint32_t read = fs_mpmc_rb_read(queue->buffer, &queue->header, &bench_fs_rb_on_message, options->batch,
+                                              thread);
+        if (read == 0) {
+            idle_count = wait_strategy_idle(&thread->wait_strategy, idle_count);
+            thread->failed++;
+        } else {
+            idle_count = 0;
+            atomic_fetch_add_explicit(&queue->consumed, read, memory_order_relaxed);
+        }
+    }
+    return NULL;
+}
+
+inline static bool bench_new_fs_rb(const struct bench_options *const options, struct bench_fs_rb *const queue,
+                                   const bool mpmc) {
+    const uint32_t slot_size = bench_slot_size(options);
+    const index_t length = fs_rb_capacity(options->capacity, slot_size);
+    //both the fs_rb and fs_mpmc_rb rely on zeroed message states
+    if (!bench_alloc(options, length, &queue->alloc)) {
+        return false;
+    }
+    queue->buffer = queue->alloc.buffer;
+    const bool created = mpmc ? new_fs_mpmc_rb(queue->buffer, &queue->header, options->capacity, slot_size) :
+                         new_fs_rb(queue->buffer, &queue->header, options->capacity, slot_size);
+    if (!created) {
+        rb_free(&queue->alloc);
+        return false;
+    }
+    queue->max_look_ahead_step = queue->header.capacity / 4;
+    atomic_init(&queue->consumed, 0);
+    return true;
+}
+
+bool bench_fs_rb_run(const struct bench_options *const options, struct bench_run *const run) {
+    struct bench_fs_rb queue;
+    if (options->consumers != 1 || !bench_new_fs_rb(options, &queue, false)) {
+        return false;
+    }
+    const bool completed = bench_run_threads(options, &queue, &bench_fs_rb_producer, &bench_fs_rb_consumer, run);
+    rb_free(&queue.alloc);
+    return completed;
+}
+
+bool bench_fs_mpmc_rb_run(const struct bench_options *const options, struct bench_run *const run) {
+    struct bench_fs_rb queue;
+    if (!bench_new_fs_rb(options, &queue, true)) {
+        return false;
+    }
+    const bool completed = bench_run_threads(options, &queue, &bench_fs_mpmc_rb_producer,
+                                             &bench_fs_mpmc_rb_consumer, run);
+    rb_free(&queue.alloc);
+    return completed;
+}
@@ -0,0 +1,94 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "bench.c"
+#include "fs_stream.h"
+#include "fs_stream.c"
+
+#define BENCH_FS_STREAM_CYCLES 4
+
+struct bench_fs_stream {
+    struct fs_stream_t stream;
+    uint8_t *buffer;
+    struct rb_alloc_t alloc;
+};
+
+static void *bench_fs_stream_producer(void *arg) {
+    struct bench_thread *const thread = (struct bench_thread *) arg;
+    const struct bench_options *const options = thread->options;
+    struct bench_fs_stream *const queue = (struct bench_fs_stream *) thread->queue;
+    uint8_t *const payload = bench_new_payload(options);
+    uint8_t *claimed_message;
+    for (uint64_t m = 0; m < options->messages; m++) {
+        uint32_t idle_count = 0;
+        while (!fs_stream_try_claim(&queue->stream, &claimed_message)) {
+            idle_count = wait_strategy_idle(&thread->wait_strategy, idle_count);
+            thread->failed++;
+        }
+        bench_write_message(options, claimed_message, payload);
+        fs_stream_commit_claim(claimed_message);
+        bench_unpark_consumers(options, fs_stream_consumer_park_word(&queue->stream));
+    }
+    free(payload);
+    return NULL;
+}
+
+static bool bench_fs_stream_on_message(uint8_t *const message, void *const context) {
+    bench_read_message((struct bench_thread *) context, message);
+    return true;
+}
+
+static bool bench_fs_stream_is_ready(void *const context) {
+    const struct bench_fs_stream *const queue = (const struct bench_fs_stream *) context;
+    return fs_stream_size(&queue->stream) != 0;
+}
+
+static void *bench_fs_stream_consumer(void *arg) {
+    struct bench_thread *const thread = (struct bench_thread *) arg;
+    const struct bench_options *const options = thread->options;
+    struct bench_fs_stream *const queue = (struct bench_fs_stream *) thread->queue;
+    const uint64_t total_messages = options->producers * options->messages;
+    uint32_t idle_count = 0;
+    bench_park_consumer(thread, fs_stream_consumer_park_word(&queue->stream), &bench_fs_stream_is_ready, queue);
+    while (thread->consumed < total_messages) {
+        if (fs_stream_read(&queue->stream, &bench_fs_stream_on_message, options->batch, thread) == 0) {
+            idle_count = wait_strategy_idle(&thread->wait_strategy, idle_count);
+            thread->failed++;
+        } else {
+            idle_count = 0;
+        }
+    }
+    return NULL;
+}
+
+bool bench_fs_stream_run(const struct bench_options *const options, struct bench_run *const run) {
+    if (options->consumers != 1) {
+        return false;
+    }
+    const uint32_t slot_size = bench_slot_size(options);
+    //the capacity is split among the cycles
+    uint32_t cycle_capacity = options->capacity / BENCH_FS_STREAM_CYCLES;
+    if (cycle_capacity == 0) {
+        cycle_capacity = 1;
+    }
+    const uint32_t length = fs_stream_capacity(cycle_capacity, slot_size, BENCH_FS_STREAM_CYCLES);
+    struct bench_fs_stream queue;
+    if (!bench_alloc(options, length, &queue.alloc)) {
+        return false;
+    }
+    queue.buffer = queue.alloc.buffer;
+    if (!new_fs_stream(queue.buffer, &queue.stream, cycle_capacity, slot_size, BENCH_FS_STREAM_CYCLES)) {
+        rb_free(&queue.alloc);
+        return false;
+    }
+    const bool completed = bench_run_threads(options, &queue, &bench_fs_stream_producer, &bench_fs_stream_consumer,
+                                             run);
+    rb_free(&queue.alloc);
+    return completed;
+}
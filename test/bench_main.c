@@ -0,0 +1,299 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "bench.h"
+#include "bench.c"
+
+struct bench_queue {
+    const char *name;
+    bool (*run)(const struct bench_options *const, struct bench_run *const);
+};
+
+static const struct bench_queue BENCH_QUEUES[] = {
+        {"vs_rb",      &bench_vs_rb_run},
+        {"fs_rb",      &bench_fs_rb_run},
+        {"fs_mpmc_rb", &bench_fs_mpmc_rb_run},
+        {"fs_stream",  &bench_fs_stream_run}
+};
+
+#define BENCH_QUEUES_COUNT (sizeof(BENCH_QUEUES) / sizeof(struct bench_queue))
+
+static const double BENCH_PERCENTILES[] = {50, 90, 99, 99.9, 99.99};
+static const char *const BENCH_PERCENTILE_NAMES[] = {"p50", "p90", "p99", "p999", "p9999"};
+
+#define BENCH_PERCENTILES_COUNT (sizeof(BENCH_PERCENTILES) / sizeof(double))
+
+static void bench_usage(const char *const program) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -q, --queue <name>         vs_rb (default), fs_rb, fs_mpmc_rb or fs_stream\n"
+            "  -p, --producers <n>        producer threads (default 1)\n"
+            "  -c, --consumers <n>        consumer threads, > 1 only for fs_mpmc_rb (default 1)\n"
+            "  -s, --message-size <b>     message size in bytes, at least 8 (default 16)\n"
+            "  -n, --capacity <n>         max messages in the queue (default 65536)\n"
+            "  -b, --batch <n>            max messages per consumer read (default 256)\n"
+            "  -m, --messages <n>         messages per producer on each run (default 10000000)\n"
+            "  -r, --runs <n>             runs (default 5)\n"
+            "  -a, --cpus <list>          cpus to pin the consumers then the producers to, ie 0,2,4-7\n"
+            "  -N, --numa-node <n>        NUMA node to bind the queue memory to (default: first touch)\n"
+            "  -H, --huge-pages           back the queue memory with 2MB pages\n"
+            "  -w, --wait <strategy>      spin (default), yield, backoff or park: the consumers sleep on the queue\n"
+            "  -P, --payload <mode>       copy (default) or pointer: pass a malloc'd message freed by the consumer\n"
+            "  -f, --format <format>      text (default), csv or json\n",
+            program);
+}
+
+static bool bench_parse_cpus(const char *const list, struct bench_options *const options) {
+    const char *cursor = list;
+    options->cpus_count = 0;
+    while (*cursor != '\0') {
+        char *end;
+        const long first = strtol(cursor, &end, 10);
+        long last = first;
+        if (end == cursor || first < 0) {
+            return false;
+        }
+        if (*end == '-') {
+            cursor = end + 1;
+            last = strtol(cursor, &end, 10);
+            if (end == cursor || last < first) {
+                return false;
+            }
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (options->cpus_count == BENCH_MAX_THREADS) {
+                return false;
+            }
+            options->cpus[options->cpus_count++] = (int) cpu;
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return false;
+        }
+        cursor = end;
+    }
+    return true;
+}
+
+static bool bench_parse_options(const int argc, char **const argv, struct bench_options *const options) {
+    static const struct option long_options[] = {
+            {"queue",        required_argument, NULL, 'q'},
+            {"producers",    required_argument, NULL, 'p'},
+            {"consumers",    required_argument, NULL, 'c'},
+            {"message-size", required_argument, NULL, 's'},
+            {"capacity",     required_argument, NULL, 'n'},
+            {"batch",        required_argument, NULL, 'b'},
+            {"messages",     required_argument, NULL, 'm'},
+            {"runs",         required_argument, NULL, 'r'},
+            {"cpus",         required_argument, NULL, 'a'},
+            {"numa-node",    required_argument, NULL, 'N'},
+            {"huge-pages",   no_argument,       NULL, 'H'},
+            {"wait",         required_argument, NULL, 'w'},
+            {"payload",      required_argument, NULL, 'P'},
+            {"format",       required_argument, NULL, 'f'},
+            {"help",         no_argument,       NULL, 'h'},
+            {NULL, 0,                           NULL, 0}
+    };
+    options->queue = "vs_rb";
+    options->producers = 1;
+    options->consumers = 1;
+    options->message_size = 16;
+    options->capacity = 64 * 1024;
+    options->batch = 256;
+    options->messages = 10000000;
+    options->runs = 5;
+    options->cpus_count = 0;
+    options->numa_node = RB_ALLOC_ANY_NUMA_NODE;
+    options->huge_pages = false;
+    options->wait = BUSY_SPIN_WAIT;
+    options->payload = BENCH_COPY_PAYLOAD;
+    options->format = BENCH_TEXT_FORMAT;
+    int option;
+    while ((option = getopt_long(argc, argv, "q:p:c:s:n:b:m:r:a:N:Hw:P:f:h", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'q':
+                options->queue = optarg;
+                break;
+            case 'p':
+                options->producers = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                options->consumers = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                options->message_size = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                options->capacity = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                options->batch = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'm':
+                options->messages = strtoull(optarg, NULL, 10);
+                break;
+            case 'r':
+                options->runs = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'a':
+                if (!bench_parse_cpus(optarg, options)) {
+                    return false;
+                }
+                break;
+            case 'N':
+                options->numa_node = (int) strtol(optarg, NULL, 10);
+                break;
+            case 'H':
+                options->huge_pages = true;
+                break;
+            case 'w':
+                if (strcmp(optarg, "spin") == 0) {
+                    options->wait = BUSY_SPIN_WAIT;
+                } else if (strcmp(optarg, "yield") == 0) {
+                    options->wait = YIELD_WAIT;
+                } else if (strcmp(optarg, "backoff") == 0) {
+                    options->wait = BACKOFF_WAIT;
+                } else if (strcmp(optarg, "park") == 0) {
+                    options->wait = PARK_WAIT;
+                } else {
+                    return false;
+                }
+                break;
+            case 'P':
+                if (strcmp(optarg, "copy") == 0) {
+                    options->payload = BENCH_COPY_PAYLOAD;
+                } else if (strcmp(optarg, "pointer") == 0) {
+                    options->payload = BENCH_POINTER_PAYLOAD;
+                } else {
+                    return false;
+                }
+                break;
+            case 'f':
+                if (strcmp(optarg, "text") == 0) {
+                    options->format = BENCH_TEXT_FORMAT;
+                } else if (strcmp(optarg, "csv") == 0) {
+                    options->format = BENCH_CSV_FORMAT;
+                } else if (strcmp(optarg, "json") == 0) {
+                    options->format = BENCH_JSON_FORMAT;
+                } else {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+    return optind == argc && options->producers > 0 && options->consumers > 0 &&
+           options->message_size >= sizeof(uint64_t) && options->capacity > 0 && options->batch > 0 &&
+           options->messages > 0 && options->runs > 0 && options->numa_node >= RB_ALLOC_ANY_NUMA_NODE;
+}
+
+static const char *bench_payload_name(const enum bench_payload payload) {
+    return payload == BENCH_POINTER_PAYLOAD ? "pointer" : "copy";
+}
+
+static void bench_print_header(const struct bench_options *const options) {
+    switch (options->format) {
+        case BENCH_CSV_FORMAT:
+            printf("queue,producers,consumers,message_size,capacity,batch,payload,run,messages,elapsed_ns,ops_per_sec,"
+                   "failed_claims,failed_reads,latency_mean_ns,latency_min_ns");
+            for (uint32_t i = 0; i < BENCH_PERCENTILES_COUNT; i++) {
+                printf(",latency_%s_ns", BENCH_PERCENTILE_NAMES[i]);
+            }
+            printf(",latency_max_ns\n");
+            break;
+        case BENCH_JSON_FORMAT:
+            printf("[\n");
+            break;
+        default:
+            printf("%s: %u producers %u consumers %u bytes messages (%s) %u capacity %u batch\n",
+                   options->queue, options->producers, options->consumers, options->message_size,
+                   bench_payload_name(options->payload), options->capacity, options->batch);
+            break;
+    }
+}
+
+static void bench_print_run(const struct bench_options *const options, const uint32_t run_index,
+                            const struct bench_run *const run) {
+    const double ops_per_sec = (run->messages * 1e9) / run->elapsed_nanos;
+    const struct histogram_t *const latency = &run->latency;
+    const uint64_t min_latency = latency->total_count == 0 ? 0 : latency->min;
+    switch (options->format) {
+        case BENCH_CSV_FORMAT:
+            printf("%s,%u,%u,%u,%u,%u,%s,%u,%lu,%lu,%.0f,%lu,%lu,%.1f,%lu", options->queue, options->producers,
+                   options->consumers, options->message_size, options->capacity, options->batch,
+                   bench_payload_name(options->payload), run_index, run->messages, run->elapsed_nanos, ops_per_sec,
+                   run->failed_claims, run->failed_reads, histogram_mean(latency), min_latency);
+            for (uint32_t i = 0; i < BENCH_PERCENTILES_COUNT; i++) {
+                printf(",%lu", histogram_value_at_percentile(latency, BENCH_PERCENTILES[i]));
+            }
+            printf(",%lu\n", latency->max);
+            break;
+        case BENCH_JSON_FORMAT:
+            printf("  {\"queue\": \"%s\", \"producers\": %u, \"consumers\": %u, \"message_size\": %u, "
+                   "\"capacity\": %u, \"batch\": %u, \"payload\": \"%s\", \"run\": %u, \"messages\": %lu, "
+                   "\"elapsed_ns\": %lu, \"ops_per_sec\": %.0f, \"failed_claims\": %lu, \"failed_reads\": %lu, "
+                   "\"latency_ns\": {\"mean\": %.1f, \"min\": %lu", options->queue, options->producers,
+                   options->consumers, options->message_size, options->capacity, options->batch,
+                   bench_payload_name(options->payload), run_index, run->messages, run->elapsed_nanos, ops_per_sec,
+                   run->failed_claims, run->failed_reads, histogram_mean(latency), min_latency);
+            for (uint32_t i = 0; i < BENCH_PERCENTILES_COUNT; i++) {
+                printf(", \"%s\": %lu", BENCH_PERCENTILE_NAMES[i],
+                       histogram_value_at_percentile(latency, BENCH_PERCENTILES[i]));
+            }
+            printf(", \"max\": %lu}}%s\n", latency->max, run_index + 1 < options->runs ? "," : "");
+            break;
+        default:
+            printf("[%u]\t%.2fM ops/sec %lu failed claims %lu failed reads latency ns: mean %.0f",
+                   run_index, ops_per_sec / 1e6, run->failed_claims, run->failed_reads, histogram_mean(latency));
+            for (uint32_t i = 0; i < BENCH_PERCENTILES_COUNT; i++) {
+                printf(" %s %lu", BENCH_PERCENTILE_NAMES[i],
+                       histogram_value_at_percentile(latency, BENCH_PERCENTILES[i]));
+            }
+            printf(" max %lu\n", latency->max);
+            break;
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    struct bench_options options;
+    if (!bench_parse_options(argc, argv, &options)) {
+        bench_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    const struct bench_queue *queue = NULL;
+    for (uint32_t i = 0; i < BENCH_QUEUES_COUNT; i++) {
+        if (strcmp(BENCH_QUEUES[i].name, options.queue) == 0) {
+            queue = &BENCH_QUEUES[i];
+        }
+    }
+    if (queue == NULL) {
+        bench_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    //each run holds its own histogram: better on the heap
+    struct bench_run *const run = malloc(sizeof(struct bench_run));
+    bench_print_header(&options);
+    for (uint32_t r = 0; r < options.runs; r++) {
+        if (!queue->run(&options, run)) {
+            fprintf(stderr, "%s can't run the requested configuration\n", options.queue);
+            free(run);
+            return EXIT_FAILURE;
+        }
+        bench_print_run(&options, r, run);
+    }
+    if (options.format == BENCH_JSON_FORMAT) {
+        printf("]\n");
+    }
+    free(run);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "bench.c"
+#include "vs_rb.h"
+#include "vs_rb.c"
+
+#define BENCH_MSG_TYPE_ID 1
+
+struct bench_vs_rb {
+    struct vs_rb_t header;
+    uint8_t *buffer;
+    struct rb_alloc_t alloc;
+};
+
+static void *bench_vs_rb_producer(void *arg) {
+    struct bench_thread *const thread = (struct bench_thread *) arg;
+    const struct bench_options *const options = thread->options;
+    struct bench_vs_rb *const queue = (struct bench_vs_rb *) thread->queue;
+    uint8_t *const buffer = queue->buffer;
+    const index_t slot_size = bench_slot_size(options);
+    uint8_t *const payload = bench_new_payload(options);
+    uint64_t claimed_position;
+    index_t claimed_index;
+    for (uint64_t m = 0; m < options->messages; m++) {
+        uint32_t idle_count = 0;
+        if (options->producers == 1) {
+            while (!vs_rb_try_sp_claim(&queue->header, buffer, slot_size, &claimed_position, &claimed_index)) {
+                idle_count = wait_strategy_idle(&thread->wait_strategy, idle_count);
+                thread->failed++;
+            }
+        } else {
+            while (!vs_rb_try_mp_claim(&queue->header, buffer, slot_size, &claimed_position, &claimed_index)) {
+                idle_count = wait_strategy_idle(&thread->wait_strategy, idle_count);
+                thread->failed++;
+            }
+        }
+        bench_write_message(options, buffer + vs_rb_encoded_msg_offset(claimed_index), payload);
+        vs_rb_commit_claim(buffer, claimed_index, BENCH_MSG_TYPE_ID, slot_size);
+        bench_unpark_consumers(options, vs_rb_consumer_park_word(&queue->header, buffer));
+    }
+    free(payload);
+    return NULL;
+}
+
+static bool bench_vs_rb_on_message(const uint32_t msg_type_id, const uint8_t *const buffer,
+                                   const index_t msg_content_index, const index_t msg_content_length,
+                                   void *const context) {
+    bench_read_message((struct bench_thread *) context, buffer + msg_content_index);
+    return true;
+}
+
+static bool bench_vs_rb_is_ready(void *const context) {
+    const struct bench_vs_rb *const queue = (const struct bench_vs_rb *) context;
+    return vs_rb_size(&queue->header, queue->buffer) != 0;
+}
+
+static void *bench_vs_rb_consumer(void *arg) {
+    struct bench_thread *const thread = (struct bench_thread *) arg;
+    const struct bench_options *const options = thread->options;
+    struct bench_vs_rb *const queue = (struct bench_vs_rb *) thread->queue;
+    const uint64_t total_messages = options->producers * options->messages;
+    uint32_t idle_count = 0;
+    bench_park_consumer(thread, vs_rb_consumer_park_word(&queue->header, queue->buffer), &bench_vs_rb_is_ready,
+                        queue);
+    while (thread->consumed < total_messages) {
+        if (vs_rb_read(&queue->header, queue->buffer, &bench_vs_rb_on_message, options->batch, thread) == 0) {
+            idle_count = wait_strategy_idle(&thread->wait_strategy, idle_count);
+            thread->failed++;
+        } else {
+            idle_count = 0;
+        }
+    }
+    return NULL;
+}
+
+bool bench_vs_rb_run(const struct bench_options *const options, struct bench_run *const run) {
+    if (options->consumers != 1) {
+        return false;
+    }
+    struct bench_vs_rb queue;
+    const index_t record_capacity = vs_rb_required_record_capacity(bench_slot_size(options));
+    const index_t length = vs_rb_capacity(options->capacity * record_capacity);
+    if (!new_vs_rb(&queue.header, length) || bench_slot_size(options) > queue.header.max_msg_length) {
+        return false;
+    }
+    //the consumer relies on zeroed records
+    if (!bench_alloc(options, length, &queue.alloc)) {
+        return false;
+    }
+    queue.buffer = queue.alloc.buffer;
+    const bool completed = bench_run_threads(options, &queue, &bench_vs_rb_producer, &bench_vs_rb_consumer, run);
+    rb_free(&queue.alloc);
+    return completed;
+}
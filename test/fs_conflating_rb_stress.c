@@ -0,0 +1,182 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "fs_conflating_rb.h"
+#include "fs_conflating_rb.c"
+
+#define FS_CONFLATING_RB_STRESS_KEYS 32
+//most of the offers are for a few keys, conflated while pending, the others for any key
+#define FS_CONFLATING_RB_STRESS_HOT_KEYS 4
+#define FS_CONFLATING_RB_STRESS_ANY_KEY_PERIOD 4
+#define FS_CONFLATING_RB_STRESS_SEED 0x9E3779B97F4A7C15ULL
+//fewer slots than keys: the producer often finds the ring buffer full
+#define FS_CONFLATING_RB_STRESS_CAPACITY 16
+#define FS_CONFLATING_RB_STRESS_OFFERS 4000000
+#define FS_CONFLATING_RB_STRESS_BATCH 8
+//the producer and the consumer yield in the middle of their work, to be interleaved even on a single CPU: the
+//consumer more often, to let the producer overwrite the pending messages
+#define FS_CONFLATING_RB_STRESS_PRODUCER_YIELD_PERIOD 61
+#define FS_CONFLATING_RB_STRESS_CONSUMER_YIELD_PERIOD 3
+//a lost final value leaves the consumer waiting for it
+#define FS_CONFLATING_RB_STRESS_TIMEOUT_NANOS 60000000000ULL
+
+/**
+ * The producer offers an increasing value for each key, picking the keys with a skewed pseudo random sequence: the
+ * pending messages of the hot keys are overwritten, while the ones of the other keys can be more than a lap behind.
+ * The consumer checks that the value of each key never goes backwards and waits for the last value offered for each
+ * key to be delivered.
+ */
+struct fs_conflating_rb_stress {
+    uint8_t *buffer;
+    struct fs_conflating_rb_t header;
+    uint64_t deadline;
+    uint64_t last_values[FS_CONFLATING_RB_STRESS_KEYS];
+    uint64_t final_values[FS_CONFLATING_RB_STRESS_KEYS];
+    uint64_t delivered;
+    uint64_t errors;
+};
+
+static inline uint64_t fs_conflating_rb_stress_nanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+static inline uint32_t fs_conflating_rb_stress_key(uint64_t *const seed) {
+    uint64_t random = *seed;
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    *seed = random;
+    if ((random % FS_CONFLATING_RB_STRESS_ANY_KEY_PERIOD) == 0) {
+        return (uint32_t) ((random >> 8) % FS_CONFLATING_RB_STRESS_KEYS);
+    }
+    return (uint32_t) ((random >> 8) % FS_CONFLATING_RB_STRESS_HOT_KEYS);
+}
+
+static void *fs_conflating_rb_stress_produce(void *const argument) {
+    struct fs_conflating_rb_stress *const stress = (struct fs_conflating_rb_stress *) argument;
+    uint64_t values[FS_CONFLATING_RB_STRESS_KEYS] = {0};
+    uint64_t seed = FS_CONFLATING_RB_STRESS_SEED;
+    for (uint64_t offer = 0; offer < FS_CONFLATING_RB_STRESS_OFFERS; offer++) {
+        const uint32_t key = fs_conflating_rb_stress_key(&seed);
+        //the values start from 1: 0 is the last value of a key never delivered
+        const uint64_t value = ++values[key];
+        while (!fs_conflating_rb_offer(stress->buffer, &stress->header, key, (const uint8_t *) &value)) {
+            if (fs_conflating_rb_stress_nanos() > stress->deadline) {
+                return NULL;
+            }
+            sched_yield();
+        }
+        if ((offer % FS_CONFLATING_RB_STRESS_PRODUCER_YIELD_PERIOD) == 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static bool fs_conflating_rb_stress_consume(const uint32_t key, const uint8_t *const message, void *const context) {
+    struct fs_conflating_rb_stress *const stress = (struct fs_conflating_rb_stress *) context;
+    uint64_t value;
+    memcpy(&value, message, sizeof(value));
+    if (key >= FS_CONFLATING_RB_STRESS_KEYS) {
+        stress->errors++;
+        return true;
+    }
+    //each offered value can be delivered at most once
+    if (value <= stress->last_values[key] || value > stress->final_values[key]) {
+        stress->errors++;
+    }
+    stress->last_values[key] = value;
+    stress->delivered++;
+    if ((stress->delivered % FS_CONFLATING_RB_STRESS_CONSUMER_YIELD_PERIOD) == 0) {
+        sched_yield();
+    }
+    return true;
+}
+
+static bool fs_conflating_rb_stress_completed(const struct fs_conflating_rb_stress *const stress) {
+    for (uint32_t key = 0; key < FS_CONFLATING_RB_STRESS_KEYS; key++) {
+        if (stress->last_values[key] != stress->final_values[key]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    struct fs_conflating_rb_stress *const stress = calloc(1, sizeof(struct fs_conflating_rb_stress));
+    const index_t length = fs_conflating_rb_capacity(FS_CONFLATING_RB_STRESS_CAPACITY, sizeof(uint64_t),
+                                                     FS_CONFLATING_RB_STRESS_KEYS);
+    const size_t aligned_length = (length + CACHE_LINE_LENGTH - 1) & ~((size_t) CACHE_LINE_LENGTH - 1);
+    stress->buffer = aligned_alloc(CACHE_LINE_LENGTH, aligned_length);
+    if (stress->buffer == NULL) {
+        free(stress);
+        return EXIT_FAILURE;
+    }
+    memset(stress->buffer, 0, aligned_length);
+    bool passed = true;
+    //no keys can't hold any message: it must be refused
+    if (new_fs_conflating_rb(stress->buffer, &stress->header, FS_CONFLATING_RB_STRESS_CAPACITY, sizeof(uint64_t), 0)) {
+        printf("a ring buffer without keys has been accepted\n");
+        passed = false;
+    }
+    if (!new_fs_conflating_rb(stress->buffer, &stress->header, FS_CONFLATING_RB_STRESS_CAPACITY, sizeof(uint64_t),
+                              FS_CONFLATING_RB_STRESS_KEYS)) {
+        printf("can't create the ring buffer\n");
+        free(stress->buffer);
+        free(stress);
+        return EXIT_FAILURE;
+    }
+    const uint64_t invalid_value = 1;
+    if (fs_conflating_rb_offer(stress->buffer, &stress->header, FS_CONFLATING_RB_STRESS_KEYS,
+                               (const uint8_t *) &invalid_value)) {
+        printf("a key out of range has been accepted\n");
+        passed = false;
+    }
+    //the producer picks the same keys
+    uint64_t seed = FS_CONFLATING_RB_STRESS_SEED;
+    for (uint64_t offer = 0; offer < FS_CONFLATING_RB_STRESS_OFFERS; offer++) {
+        stress->final_values[fs_conflating_rb_stress_key(&seed)]++;
+    }
+    stress->deadline = fs_conflating_rb_stress_nanos() + FS_CONFLATING_RB_STRESS_TIMEOUT_NANOS;
+    pthread_t producer_thread;
+    pthread_create(&producer_thread, NULL, fs_conflating_rb_stress_produce, stress);
+    while (!fs_conflating_rb_stress_completed(stress) && fs_conflating_rb_stress_nanos() <= stress->deadline) {
+        if (fs_conflating_rb_read(stress->buffer, &stress->header, fs_conflating_rb_stress_consume,
+                                  FS_CONFLATING_RB_STRESS_BATCH, stress) == 0) {
+            sched_yield();
+        }
+    }
+    pthread_join(producer_thread, NULL);
+    //nothing can be left after the final values
+    while (fs_conflating_rb_read(stress->buffer, &stress->header, fs_conflating_rb_stress_consume,
+                                 FS_CONFLATING_RB_STRESS_BATCH, stress) != 0) {
+    }
+    if (!fs_conflating_rb_stress_completed(stress)) {
+        for (uint32_t key = 0; key < FS_CONFLATING_RB_STRESS_KEYS; key++) {
+            if (stress->last_values[key] != stress->final_values[key]) {
+                printf("key %u: the last delivered value is %lu instead of %lu\n", key, stress->last_values[key],
+                       stress->final_values[key]);
+            }
+        }
+        passed = false;
+    }
+    if (stress->errors != 0) {
+        printf("%lu values delivered out of order or twice\n", stress->errors);
+        passed = false;
+    }
+    printf("delivered %lu values of %u offered\n", stress->delivered, FS_CONFLATING_RB_STRESS_OFFERS);
+    free(stress->buffer);
+    free(stress);
+    printf("fs_conflating_rb: %s\n", passed ? "passed" : "failed");
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
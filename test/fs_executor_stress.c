@@ -0,0 +1,213 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "fs_executor.h"
+#include "fs_executor.c"
+
+#define FS_EXECUTOR_STRESS_WORKERS 4
+#define FS_EXECUTOR_STRESS_DEQUE_CAPACITY 256
+//the smallest injection queue: the submits often find it full
+#define FS_EXECUTOR_STRESS_INJECTION_CAPACITY 2
+#define FS_EXECUTOR_STRESS_ROUNDS 4
+#define FS_EXECUTOR_STRESS_ROOTS 64
+#define FS_EXECUTOR_STRESS_TREE_DEPTH 8
+//long enough for the idle workers to park for hundreds of milliseconds
+#define FS_EXECUTOR_STRESS_IDLE_GAP_MICROS 1000000
+#define FS_EXECUTOR_STRESS_MAX_PARK_NANOS 2000000000ULL
+//a lost wake up leaves a worker parked for longer than this
+#define FS_EXECUTOR_STRESS_RENDEZVOUS_NANOS 200000000ULL
+#define FS_EXECUTOR_STRESS_TIMEOUT_NANOS 10000000000ULL
+
+/**
+ * Submits trees of tasks, each spawning its children on the worker running it, and checks that every task completes
+ * after idle gaps long enough to let the workers park.
+ * Then it submits a task for each worker, that completes in time only if all of them are running at the same time:
+ * a worker left parked by a lost wake up makes it fail.
+ */
+struct fs_executor_stress {
+    _Atomic uint64_t completed_tasks;
+    _Atomic uint32_t rendezvous_arrived;
+    _Atomic uint32_t rendezvous_missed;
+};
+
+static struct fs_executor_stress stress;
+
+static inline uint64_t fs_executor_stress_nanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+static inline uint64_t fs_executor_stress_tree_tasks(void) {
+    return (1UL << (FS_EXECUTOR_STRESS_TREE_DEPTH + 1)) - 1;
+}
+
+static void fs_executor_stress_tree(struct fs_executor_worker_t *const worker, void *const argument) {
+    const uintptr_t depth = (uintptr_t) argument;
+    if (depth > 0) {
+        for (uint32_t child = 0; child < 2; child++) {
+            //both the deque and the injection queue are full: the other workers are draining them
+            while (!fs_executor_spawn(worker, fs_executor_stress_tree, (void *) (depth - 1))) {
+                sched_yield();
+            }
+        }
+    }
+    atomic_fetch_add_explicit(&stress.completed_tasks, 1, memory_order_relaxed);
+}
+
+static void fs_executor_stress_rendezvous(struct fs_executor_worker_t *const worker, void *const argument) {
+    const uint64_t deadline = fs_executor_stress_nanos() + FS_EXECUTOR_STRESS_RENDEZVOUS_NANOS;
+    atomic_fetch_add_explicit(&stress.rendezvous_arrived, 1, memory_order_relaxed);
+    while (atomic_load_explicit(&stress.rendezvous_arrived, memory_order_relaxed) < FS_EXECUTOR_STRESS_WORKERS) {
+        if (fs_executor_stress_nanos() > deadline) {
+            atomic_fetch_add_explicit(&stress.rendezvous_missed, 1, memory_order_relaxed);
+            break;
+        }
+        sched_yield();
+    }
+    atomic_fetch_add_explicit(&stress.completed_tasks, 1, memory_order_relaxed);
+}
+
+static void fs_executor_stress_submit(struct fs_executor_t *const executor, const fs_executor_task_function run,
+                                      void *const argument) {
+    while (!fs_executor_submit(executor, run, argument)) {
+        sched_yield();
+    }
+}
+
+static bool fs_executor_stress_await(const uint64_t expected_tasks) {
+    const uint64_t deadline = fs_executor_stress_nanos() + FS_EXECUTOR_STRESS_TIMEOUT_NANOS;
+    while (atomic_load_explicit(&stress.completed_tasks, memory_order_relaxed) < expected_tasks) {
+        if (fs_executor_stress_nanos() > deadline) {
+            return false;
+        }
+        usleep(1000);
+    }
+    return atomic_load_explicit(&stress.completed_tasks, memory_order_relaxed) == expected_tasks;
+}
+
+struct fs_executor_stress_waiter {
+    _Atomic uint32_t *park_word;
+    uint64_t max_park_nanos;
+};
+
+static bool fs_executor_stress_is_ready(void *const context) {
+    return atomic_load_explicit((_Atomic bool *) context, memory_order_relaxed);
+}
+
+static _Atomic bool park_word_ready;
+
+static void *fs_executor_stress_park(void *const argument) {
+    const struct fs_executor_stress_waiter *const waiter = (const struct fs_executor_stress_waiter *) argument;
+    struct wait_strategy_t wait_strategy;
+    new_park_wait_strategy(&wait_strategy, 0, 0, waiter->max_park_nanos, waiter->park_word,
+                           fs_executor_stress_is_ready, &park_word_ready);
+    //a single idle, already past the spins and the yields: it parks for max_park_nanos
+    wait_strategy_idle(&wait_strategy, UINT32_MAX);
+    return NULL;
+}
+
+/**
+ * The executor workers share a single park word: a waiter returning on timeout must not leave the others parked
+ * without being woken up by the next unpark.
+ */
+static bool fs_executor_stress_shared_park_word(void) {
+    _Atomic uint32_t park_word;
+    atomic_init(&park_word, 0);
+    atomic_init(&park_word_ready, false);
+    struct fs_executor_stress_waiter sleeping = {&park_word, FS_EXECUTOR_STRESS_MAX_PARK_NANOS};
+    struct fs_executor_stress_waiter timing_out = {&park_word, 10000000};
+    pthread_t sleeping_thread;
+    pthread_t timing_out_thread;
+    pthread_create(&sleeping_thread, NULL, fs_executor_stress_park, &sleeping);
+    usleep(50000);
+    pthread_create(&timing_out_thread, NULL, fs_executor_stress_park, &timing_out);
+    pthread_join(timing_out_thread, NULL);
+    const uint64_t unpark_nanos = fs_executor_stress_nanos();
+    atomic_store_explicit(&park_word_ready, true, memory_order_relaxed);
+    wait_strategy_unpark(&park_word);
+    pthread_join(sleeping_thread, NULL);
+    const bool passed = fs_executor_stress_nanos() - unpark_nanos < FS_EXECUTOR_STRESS_RENDEZVOUS_NANOS;
+    printf("shared park word: %s\n", passed ? "passed" : "failed");
+    return passed;
+}
+
+static bool fs_executor_stress_run(const char *const name, const struct wait_strategy_t *const wait_strategy) {
+    struct fs_executor_t *const executor = malloc(sizeof(struct fs_executor_t));
+    if (!new_fs_executor(executor, FS_EXECUTOR_STRESS_WORKERS, FS_EXECUTOR_STRESS_DEQUE_CAPACITY,
+                         FS_EXECUTOR_STRESS_INJECTION_CAPACITY, wait_strategy)) {
+        printf("%s: can't create the executor\n", name);
+        free(executor);
+        return false;
+    }
+    if (!fs_executor_start(executor)) {
+        printf("%s: can't start the executor\n", name);
+        free(executor);
+        return false;
+    }
+    bool passed = true;
+    for (uint32_t round = 0; passed && round < FS_EXECUTOR_STRESS_ROUNDS; round++) {
+        usleep(FS_EXECUTOR_STRESS_IDLE_GAP_MICROS);
+        atomic_store_explicit(&stress.completed_tasks, 0, memory_order_relaxed);
+        for (uint32_t root = 0; root < FS_EXECUTOR_STRESS_ROOTS; root++) {
+            fs_executor_stress_submit(executor, fs_executor_stress_tree, (void *) FS_EXECUTOR_STRESS_TREE_DEPTH);
+        }
+        const uint64_t expected_tasks = FS_EXECUTOR_STRESS_ROOTS * fs_executor_stress_tree_tasks();
+        if (!fs_executor_stress_await(expected_tasks)) {
+            printf("%s: round %u completed %lu tasks instead of %lu\n", name, round,
+                   atomic_load_explicit(&stress.completed_tasks, memory_order_relaxed), expected_tasks);
+            passed = false;
+            break;
+        }
+        usleep(FS_EXECUTOR_STRESS_IDLE_GAP_MICROS);
+        atomic_store_explicit(&stress.completed_tasks, 0, memory_order_relaxed);
+        atomic_store_explicit(&stress.rendezvous_arrived, 0, memory_order_relaxed);
+        atomic_store_explicit(&stress.rendezvous_missed, 0, memory_order_relaxed);
+        for (uint32_t worker = 0; worker < FS_EXECUTOR_STRESS_WORKERS; worker++) {
+            fs_executor_stress_submit(executor, fs_executor_stress_rendezvous, NULL);
+        }
+        if (!fs_executor_stress_await(FS_EXECUTOR_STRESS_WORKERS) ||
+            atomic_load_explicit(&stress.rendezvous_missed, memory_order_relaxed) != 0) {
+            printf("%s: round %u the workers haven't been all woken up\n", name, round);
+            passed = false;
+        }
+    }
+    fs_executor_stop(executor);
+    free(executor);
+    printf("%s: %s\n", name, passed ? "passed" : "failed");
+    return passed;
+}
+
+int main() {
+    struct wait_strategy_t wait_strategy;
+    bool passed = true;
+    new_yield_wait_strategy(&wait_strategy);
+    //a single slot injection queue can't work: it must be refused
+    struct fs_executor_t *const executor = malloc(sizeof(struct fs_executor_t));
+    if (new_fs_executor(executor, FS_EXECUTOR_STRESS_WORKERS, FS_EXECUTOR_STRESS_DEQUE_CAPACITY, 1, &wait_strategy)) {
+        printf("a single slot injection queue has been accepted\n");
+        fs_executor_stop(executor);
+        passed = false;
+    }
+    //an executor never started just releases its memory
+    if (new_fs_executor(executor, FS_EXECUTOR_STRESS_WORKERS, FS_EXECUTOR_STRESS_DEQUE_CAPACITY,
+                        FS_EXECUTOR_STRESS_INJECTION_CAPACITY, &wait_strategy)) {
+        fs_executor_stop(executor);
+    }
+    free(executor);
+    passed &= fs_executor_stress_shared_park_word();
+    passed &= fs_executor_stress_run("yield", &wait_strategy);
+    //the park word and condition are replaced by the executor ones
+    if (!new_park_wait_strategy(&wait_strategy, 10, 10, FS_EXECUTOR_STRESS_MAX_PARK_NANOS, NULL, NULL, NULL)) {
+        return EXIT_FAILURE;
+    }
+    passed &= fs_executor_stress_run("park", &wait_strategy);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
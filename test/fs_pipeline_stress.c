@@ -0,0 +1,262 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "fs_pipeline.h"
+#include "fs_pipeline.c"
+
+#define FS_PIPELINE_STRESS_STAGES 4
+#define FS_PIPELINE_STRESS_MESSAGES 1000000
+//small rings: the producers often find them full and the consumers empty
+#define FS_PIPELINE_STRESS_CAPACITY 64
+#define FS_PIPELINE_STRESS_MAX_LOOK_AHEAD_STEP 16
+#define FS_PIPELINE_STRESS_BATCH 32
+//the stages yield in the middle of their batches, to be interleaved even on a single CPU
+#define FS_PIPELINE_STRESS_YIELD_PERIOD 7
+//a stage reading the messages out of order can wait forever for the last ones
+#define FS_PIPELINE_STRESS_TIMEOUT_NANOS 60000000000ULL
+
+/**
+ * A message stamped by each pipeline stage in turn: a stage finding a stamp missing, or one of the next stages
+ * already there, has read a message not yet processed by the previous stage, or one already overwritten.
+ */
+struct fs_pipeline_stress_message {
+    uint32_t sequence;
+    uint8_t stamps[FS_PIPELINE_STRESS_STAGES];
+};
+
+struct fs_pipeline_stress_stage {
+    struct fs_pipeline_stage_t stage;
+    uint8_t *buffer;
+    uint32_t expected_sequence;
+    uint64_t errors;
+};
+
+struct fs_pipeline_stress_producer {
+    uint8_t *buffer;
+    const struct fs_rb_t *ring;
+};
+
+static uint64_t deadline;
+
+static inline uint64_t fs_pipeline_stress_nanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+static inline bool fs_pipeline_stress_timed_out(void) {
+    return fs_pipeline_stress_nanos() > deadline;
+}
+
+static inline uint8_t *fs_pipeline_stress_alloc(const index_t length) {
+    const size_t aligned_length = (length + CACHE_LINE_LENGTH - 1) & ~((size_t) CACHE_LINE_LENGTH - 1);
+    uint8_t *const buffer = aligned_alloc(CACHE_LINE_LENGTH, aligned_length);
+    if (buffer != NULL) {
+        memset(buffer, 0, aligned_length);
+    }
+    return buffer;
+}
+
+static void *fs_pipeline_stress_produce(void *const argument) {
+    const struct fs_pipeline_stress_producer *const producer = (const struct fs_pipeline_stress_producer *) argument;
+    for (uint32_t sequence = 0; sequence < FS_PIPELINE_STRESS_MESSAGES; sequence++) {
+        uint8_t *claimed;
+        while (!try_fs_rb_sp_claim(producer->buffer, producer->ring, FS_PIPELINE_STRESS_MAX_LOOK_AHEAD_STEP,
+                                   &claimed)) {
+            if (fs_pipeline_stress_timed_out()) {
+                return NULL;
+            }
+            sched_yield();
+        }
+        struct fs_pipeline_stress_message message = {.sequence = sequence};
+        //the slot holds the stamps of the message of the previous lap
+        memcpy(claimed, &message, sizeof(message));
+        fs_rb_commit_claim(claimed);
+    }
+    return NULL;
+}
+
+static bool fs_pipeline_stress_stamp(uint8_t *const message_address, void *const context) {
+    struct fs_pipeline_stress_stage *const stage = (struct fs_pipeline_stress_stage *) context;
+    struct fs_pipeline_stress_message message;
+    memcpy(&message, message_address, sizeof(message));
+    if (message.sequence != stage->expected_sequence) {
+        stage->errors++;
+    }
+    for (uint32_t index = 0; index < FS_PIPELINE_STRESS_STAGES; index++) {
+        if (message.stamps[index] != (index < stage->stage.index ? 1 : 0)) {
+            stage->errors++;
+        }
+    }
+    message.stamps[stage->stage.index] = 1;
+    memcpy(message_address, &message, sizeof(message));
+    stage->expected_sequence = message.sequence + 1;
+    if ((message.sequence % FS_PIPELINE_STRESS_YIELD_PERIOD) == stage->stage.index) {
+        sched_yield();
+    }
+    return true;
+}
+
+static void *fs_pipeline_stress_process(void *const argument) {
+    struct fs_pipeline_stress_stage *const stage = (struct fs_pipeline_stress_stage *) argument;
+    while (stage->expected_sequence < FS_PIPELINE_STRESS_MESSAGES && !fs_pipeline_stress_timed_out()) {
+        if (fs_pipeline_stage_process(stage->buffer, &stage->stage, fs_pipeline_stress_stamp,
+                                      FS_PIPELINE_STRESS_BATCH, stage) == 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+/**
+ * One producer and a thread for each stage: every stage checks the order of the messages and the stamps of the
+ * previous stages.
+ */
+static bool fs_pipeline_stress_pipeline(void) {
+    const index_t length = fs_pipeline_capacity(FS_PIPELINE_STRESS_CAPACITY,
+                                                sizeof(struct fs_pipeline_stress_message),
+                                                FS_PIPELINE_STRESS_STAGES);
+    uint8_t *const buffer = fs_pipeline_stress_alloc(length);
+    struct fs_pipeline_t pipeline;
+    if (buffer == NULL || !new_fs_pipeline(buffer, &pipeline, FS_PIPELINE_STRESS_CAPACITY,
+                                           sizeof(struct fs_pipeline_stress_message), FS_PIPELINE_STRESS_STAGES)) {
+        printf("pipeline: can't create the pipeline\n");
+        free(buffer);
+        return false;
+    }
+    struct fs_pipeline_stress_stage stages[FS_PIPELINE_STRESS_STAGES];
+    pthread_t stage_threads[FS_PIPELINE_STRESS_STAGES];
+    for (uint32_t index = 0; index < FS_PIPELINE_STRESS_STAGES; index++) {
+        stages[index].buffer = buffer;
+        stages[index].expected_sequence = 0;
+        stages[index].errors = 0;
+        new_fs_pipeline_stage(&pipeline, &stages[index].stage, index);
+    }
+    //a stage index past the last one must be refused
+    struct fs_pipeline_stage_t invalid_stage;
+    bool passed = !new_fs_pipeline_stage(&pipeline, &invalid_stage, FS_PIPELINE_STRESS_STAGES);
+    struct fs_pipeline_stress_producer producer = {buffer, &pipeline.ring};
+    pthread_t producer_thread;
+    deadline = fs_pipeline_stress_nanos() + FS_PIPELINE_STRESS_TIMEOUT_NANOS;
+    pthread_create(&producer_thread, NULL, fs_pipeline_stress_produce, &producer);
+    for (uint32_t index = 0; index < FS_PIPELINE_STRESS_STAGES; index++) {
+        pthread_create(&stage_threads[index], NULL, fs_pipeline_stress_process, &stages[index]);
+    }
+    pthread_join(producer_thread, NULL);
+    for (uint32_t index = 0; index < FS_PIPELINE_STRESS_STAGES; index++) {
+        pthread_join(stage_threads[index], NULL);
+        if (stages[index].errors != 0 || stages[index].expected_sequence != FS_PIPELINE_STRESS_MESSAGES) {
+            printf("pipeline: stage %u processed %u messages with %lu errors\n", index,
+                   stages[index].expected_sequence, stages[index].errors);
+            passed = false;
+        }
+    }
+    free(buffer);
+    printf("pipeline: %s\n", passed ? "passed" : "failed");
+    return passed;
+}
+
+struct fs_pipeline_stress_transfer {
+    uint8_t *buffer;
+    const struct fs_rb_t *ring;
+    uint8_t *next_buffer;
+    const struct fs_rb_t *next_ring;
+    uint32_t expected_sequence;
+    uint64_t errors;
+};
+
+static bool fs_pipeline_stress_hand_off(uint8_t *const message_address, uint8_t *const next_message_address,
+                                        void *const context) {
+    struct fs_pipeline_stress_transfer *const transfer = (struct fs_pipeline_stress_transfer *) context;
+    struct fs_pipeline_stress_message message;
+    memcpy(&message, message_address, sizeof(message));
+    if (message.sequence != transfer->expected_sequence) {
+        transfer->errors++;
+    }
+    transfer->expected_sequence = message.sequence + 1;
+    message.stamps[0] = 1;
+    memcpy(next_message_address, &message, sizeof(message));
+    return true;
+}
+
+static void *fs_pipeline_stress_transfer(void *const argument) {
+    struct fs_pipeline_stress_transfer *const transfer = (struct fs_pipeline_stress_transfer *) argument;
+    while (transfer->expected_sequence < FS_PIPELINE_STRESS_MESSAGES && !fs_pipeline_stress_timed_out()) {
+        if (fs_rb_transfer(transfer->buffer, transfer->ring, transfer->next_buffer, transfer->next_ring,
+                           FS_PIPELINE_STRESS_MAX_LOOK_AHEAD_STEP, fs_pipeline_stress_hand_off,
+                           FS_PIPELINE_STRESS_BATCH, transfer) == 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static bool fs_pipeline_stress_read(uint8_t *const message_address, void *const context) {
+    struct fs_pipeline_stress_transfer *const consumer = (struct fs_pipeline_stress_transfer *) context;
+    struct fs_pipeline_stress_message message;
+    memcpy(&message, message_address, sizeof(message));
+    if (message.sequence != consumer->expected_sequence || message.stamps[0] != 1) {
+        consumer->errors++;
+    }
+    consumer->expected_sequence = message.sequence + 1;
+    return true;
+}
+
+/**
+ * One producer, a thread transferring each message into a second fs_rb and its consumer: both check the order of
+ * the messages, the consumer that each one has been handed off by the transfer.
+ */
+static bool fs_pipeline_stress_fs_rb_transfer(void) {
+    const index_t length = fs_rb_capacity(FS_PIPELINE_STRESS_CAPACITY, sizeof(struct fs_pipeline_stress_message));
+    uint8_t *const buffer = fs_pipeline_stress_alloc(length);
+    uint8_t *const next_buffer = fs_pipeline_stress_alloc(length);
+    struct fs_rb_t ring;
+    struct fs_rb_t next_ring;
+    if (buffer == NULL || next_buffer == NULL ||
+        !new_fs_rb(buffer, &ring, FS_PIPELINE_STRESS_CAPACITY, sizeof(struct fs_pipeline_stress_message)) ||
+        !new_fs_rb(next_buffer, &next_ring, FS_PIPELINE_STRESS_CAPACITY, sizeof(struct fs_pipeline_stress_message))) {
+        printf("fs_rb_transfer: can't create the ring buffers\n");
+        free(buffer);
+        free(next_buffer);
+        return false;
+    }
+    struct fs_pipeline_stress_producer producer = {buffer, &ring};
+    struct fs_pipeline_stress_transfer transfer = {buffer, &ring, next_buffer, &next_ring, 0, 0};
+    struct fs_pipeline_stress_transfer consumer = {next_buffer, &next_ring, NULL, NULL, 0, 0};
+    pthread_t producer_thread;
+    pthread_t transfer_thread;
+    deadline = fs_pipeline_stress_nanos() + FS_PIPELINE_STRESS_TIMEOUT_NANOS;
+    pthread_create(&producer_thread, NULL, fs_pipeline_stress_produce, &producer);
+    pthread_create(&transfer_thread, NULL, fs_pipeline_stress_transfer, &transfer);
+    while (consumer.expected_sequence < FS_PIPELINE_STRESS_MESSAGES && !fs_pipeline_stress_timed_out()) {
+        if (fs_rb_read(next_buffer, &next_ring, fs_pipeline_stress_read, FS_PIPELINE_STRESS_BATCH, &consumer) == 0) {
+            sched_yield();
+        }
+    }
+    pthread_join(producer_thread, NULL);
+    pthread_join(transfer_thread, NULL);
+    const bool passed = transfer.errors == 0 && consumer.errors == 0 &&
+                        consumer.expected_sequence == FS_PIPELINE_STRESS_MESSAGES;
+    if (!passed) {
+        printf("fs_rb_transfer: the consumer read %u messages, the transfer found %lu errors and the consumer %lu\n",
+               consumer.expected_sequence, transfer.errors, consumer.errors);
+    }
+    free(buffer);
+    free(next_buffer);
+    printf("fs_rb_transfer: %s\n", passed ? "passed" : "failed");
+    return passed;
+}
+
+int main() {
+    bool passed = fs_pipeline_stress_pipeline();
+    passed &= fs_pipeline_stress_fs_rb_transfer();
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
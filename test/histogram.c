@@ -0,0 +1,103 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_HISTOGRAM_C
+#define FRANZ_FLOW_HISTOGRAM_C
+
+#include <string.h>
+#include "histogram.h"
+
+static inline void new_histogram(struct histogram_t *const histogram) {
+    memset(histogram, 0, sizeof(struct histogram_t));
+    histogram->min = UINT64_MAX;
+}
+
+inline static uint32_t histogram_bucket_index(const uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return (uint32_t) value;
+    }
+    //the sub bucket is given by the HISTOGRAM_SUB_BUCKET_BITS most significant bits of the value
+    const uint32_t shift = (63 - __builtin_clzll(value)) - (HISTOGRAM_SUB_BUCKET_BITS - 1);
+    const uint32_t sub_bucket = (uint32_t) (value >> shift) - HISTOGRAM_HALF_SUB_BUCKETS;
+    return HISTOGRAM_SUB_BUCKETS + ((shift - 1) * HISTOGRAM_HALF_SUB_BUCKETS) + sub_bucket;
+}
+
+inline static uint64_t histogram_highest_equivalent_value(const uint32_t index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+    const uint32_t shift = ((index - HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_HALF_SUB_BUCKETS) + 1;
+    const uint64_t sub_bucket = ((index - HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_HALF_SUB_BUCKETS) +
+                                HISTOGRAM_HALF_SUB_BUCKETS;
+    return (sub_bucket << shift) + ((1UL << shift) - 1);
+}
+
+static inline void histogram_record(struct histogram_t *const histogram, const uint64_t value) {
+    histogram->counts[histogram_bucket_index(value)]++;
+    histogram->total_count++;
+    histogram->sum += value;
+    if (value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+static inline void histogram_record_corrected(struct histogram_t *const histogram, const uint64_t value,
+                                              const uint64_t expected_interval) {
+    histogram_record(histogram, value);
+    if (expected_interval == 0) {
+        return;
+    }
+    for (uint64_t missing_value = value - expected_interval;
+         missing_value >= expected_interval && missing_value < value;
+         missing_value -= expected_interval) {
+        histogram_record(histogram, missing_value);
+    }
+}
+
+static inline void histogram_add(struct histogram_t *const histogram, const struct histogram_t *const other) {
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        histogram->counts[i] += other->counts[i];
+    }
+    histogram->total_count += other->total_count;
+    histogram->sum += other->sum;
+    if (other->min < histogram->min) {
+        histogram->min = other->min;
+    }
+    if (other->max > histogram->max) {
+        histogram->max = other->max;
+    }
+}
+
+static inline uint64_t histogram_value_at_percentile(const struct histogram_t *const histogram,
+                                                     const double percentile) {
+    if (histogram->total_count == 0) {
+        return 0;
+    }
+    uint64_t count_at_percentile = (uint64_t) (((percentile / 100.0) * histogram->total_count) + 0.5);
+    if (count_at_percentile == 0) {
+        count_at_percentile = 1;
+    }
+    uint64_t total_count = 0;
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        total_count += histogram->counts[i];
+        if (total_count >= count_at_percentile) {
+            const uint64_t value = histogram_highest_equivalent_value(i);
+            //no need to report a value bigger than the max recorded one
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+static inline double histogram_mean(const struct histogram_t *const histogram) {
+    if (histogram->total_count == 0) {
+        return 0;
+    }
+    return (double) histogram->sum / histogram->total_count;
+}
+
+#endif //FRANZ_FLOW_HISTOGRAM_C
@@ -0,0 +1,58 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#ifndef FRANZ_FLOW_HISTOGRAM_H
+#define FRANZ_FLOW_HISTOGRAM_H
+
+#include <stdint.h>
+
+/**
+ * Values lower than 2^HISTOGRAM_SUB_BUCKET_BITS are recorded exactly, the others with a relative error
+ * lower than 2^-(HISTOGRAM_SUB_BUCKET_BITS - 1) (ie < 1.6%).
+ */
+#define HISTOGRAM_SUB_BUCKET_BITS 7
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_HALF_SUB_BUCKETS (HISTOGRAM_SUB_BUCKETS / 2)
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS + ((64 - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_HALF_SUB_BUCKETS))
+
+/**
+ * An HDR-style log-linear histogram of uint64_t values (ie nanoseconds): it has a fixed size and never allocates.
+ */
+struct histogram_t {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total_count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+};
+
+static inline void new_histogram(struct histogram_t *const histogram);
+
+static inline void histogram_record(struct histogram_t *const histogram, const uint64_t value);
+
+/**
+ * Record a value and, if it is bigger than the expected interval between 2 values, the values that would have been
+ * recorded if the recorder wasn't stalled: it corrects the coordinated omission of a recorder that waits a response
+ * before sending the next request.
+ *
+ * @param expected_interval     the expected interval between 2 recorded values: 0 to disable the correction
+ */
+static inline void histogram_record_corrected(struct histogram_t *const histogram, const uint64_t value,
+                                              const uint64_t expected_interval);
+
+/**
+ * Add to {@code histogram} all the values recorded by {@code other}.
+ */
+static inline void histogram_add(struct histogram_t *const histogram, const struct histogram_t *const other);
+
+/**
+ * @param percentile            from 0 to 100
+ * @returns                     the highest value equivalent to the recorded one at the given percentile
+ */
+static inline uint64_t histogram_value_at_percentile(const struct histogram_t *const histogram,
+                                                     const double percentile);
+
+static inline double histogram_mean(const struct histogram_t *const histogram);
+
+#endif //FRANZ_FLOW_HISTOGRAM_H
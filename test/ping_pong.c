@@ -0,0 +1,410 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/user.h>
+#include "bench.h"
+#include "bench.c"
+#include "shm_rb.h"
+#include "shm_rb.c"
+
+#define PING_PONG_MSG_TYPE_ID 1
+#define PING_PONG_STOP UINT64_MAX
+#define PING_PONG_VS_RB_CAPACITY (64 * 1024)
+#define PING_PONG_FS_RB_CAPACITY 1024
+
+static const char *const PING_PONG_REQUEST_PATH = "/dev/shm/franz_flow_ping_pong_request.ipc";
+static const char *const PING_PONG_RESPONSE_PATH = "/dev/shm/franz_flow_ping_pong_response.ipc";
+
+static const double PING_PONG_PERCENTILES[] = {50, 90, 99, 99.9, 99.99};
+static const char *const PING_PONG_PERCENTILE_NAMES[] = {"p50", "p90", "p99", "p999", "p9999"};
+
+#define PING_PONG_PERCENTILES_COUNT (sizeof(PING_PONG_PERCENTILES) / sizeof(double))
+
+enum ping_pong_queue {
+    PING_PONG_VS_RB,
+    PING_PONG_FS_RB
+};
+
+struct ping_pong_options {
+    enum ping_pong_queue queue;
+    bool processes;                     /*  ping and pong in 2 processes over shared memory files                   */
+    uint32_t message_size;              /*  at least 8 bytes, to hold the sequence                                  */
+    uint64_t messages;
+    uint64_t warmup_messages;
+    uint64_t interval_nanos;            /*  the send interval: 0 to send back to back                               */
+    int cpus[2];                        /*  ping and pong cpus, -1 to not pin them                                  */
+    bool csv;
+};
+
+/**
+ * A single producer single consumer ring, allocated on the heap or mapped from a shared memory file.
+ */
+struct ping_pong_channel {
+    enum ping_pong_queue queue;
+    uint32_t message_size;
+    struct vs_rb_t vs_rb;
+    struct fs_rb_t fs_rb;
+    uint8_t *buffer;
+    struct shm_rb_t shm;                /*  processes only                                                          */
+};
+
+struct ping_pong {
+    const struct ping_pong_options *options;
+    struct ping_pong_channel request;
+    struct ping_pong_channel response;
+};
+
+static bool ping_pong_new_channel(const struct ping_pong_options *const options, const char *const path,
+                                  struct ping_pong_channel *const channel) {
+    channel->queue = options->queue;
+    channel->message_size = options->message_size;
+    if (options->processes) {
+        //the creator unlink the file after the benchmark
+        const bool created = options->queue == PING_PONG_VS_RB ?
+                             shm_vs_rb_create(path, PING_PONG_VS_RB_CAPACITY, SHM_RB_POPULATE, &channel->shm,
+                                              &channel->vs_rb) :
+                             shm_fs_rb_create(path, PING_PONG_FS_RB_CAPACITY, options->message_size,
+                                              SHM_RB_POPULATE, &channel->shm, &channel->fs_rb);
+        channel->buffer = channel->shm.buffer;
+        return created;
+    }
+    index_t length;
+    if (options->queue == PING_PONG_VS_RB) {
+        length = vs_rb_capacity(PING_PONG_VS_RB_CAPACITY);
+        if (!new_vs_rb(&channel->vs_rb, length)) {
+            return false;
+        }
+        channel->buffer = aligned_alloc(PAGE_SIZE, length);
+    } else {
+        length = fs_rb_capacity(PING_PONG_FS_RB_CAPACITY, options->message_size);
+        channel->buffer = aligned_alloc(PAGE_SIZE, length);
+        if (!new_fs_rb(channel->buffer, &channel->fs_rb, PING_PONG_FS_RB_CAPACITY, options->message_size)) {
+            free(channel->buffer);
+            return false;
+        }
+    }
+    memset(channel->buffer, 0, length);
+    return true;
+}
+
+static bool ping_pong_attach_channel(const struct ping_pong_options *const options, const char *const path,
+                                     struct ping_pong_channel *const channel) {
+    channel->queue = options->queue;
+    channel->message_size = options->message_size;
+    const bool attached = options->queue == PING_PONG_VS_RB ?
+                          shm_vs_rb_attach(path, SHM_RB_POPULATE, &channel->shm, &channel->vs_rb) :
+                          shm_fs_rb_attach(path, SHM_RB_POPULATE, &channel->shm, &channel->fs_rb);
+    channel->buffer = channel->shm.buffer;
+    return attached;
+}
+
+static void ping_pong_close_channel(const struct ping_pong_options *const options,
+                                    struct ping_pong_channel *const channel) {
+    if (options->processes) {
+        shm_rb_close(&channel->shm);
+    } else {
+        free(channel->buffer);
+    }
+}
+
+static void ping_pong_send(struct ping_pong_channel *const channel, const uint8_t *const message) {
+    uint8_t *const buffer = channel->buffer;
+    if (channel->queue == PING_PONG_VS_RB) {
+        uint64_t claimed_position;
+        index_t claimed_index;
+        while (!vs_rb_try_sp_claim(&channel->vs_rb, buffer, channel->message_size, &claimed_position,
+                                   &claimed_index)) {
+            __asm__ __volatile__("pause;");
+        }
+        memcpy(buffer + vs_rb_encoded_msg_offset(claimed_index), message, channel->message_size);
+        vs_rb_commit_claim(buffer, claimed_index, PING_PONG_MSG_TYPE_ID, channel->message_size);
+    } else {
+        uint8_t *claimed_message;
+        while (!try_fs_rb_sp_claim(buffer, &channel->fs_rb, 1, &claimed_message)) {
+            __asm__ __volatile__("pause;");
+        }
+        memcpy(claimed_message, message, channel->message_size);
+        fs_rb_commit_claim(claimed_message);
+    }
+}
+
+struct ping_pong_received {
+    uint8_t *message;
+    uint32_t message_size;
+};
+
+static bool ping_pong_on_vs_rb_message(const uint32_t msg_type_id, const uint8_t *const buffer,
+                                       const index_t msg_content_index, const index_t msg_content_length,
+                                       void *const context) {
+    struct ping_pong_received *const received = (struct ping_pong_received *) context;
+    memcpy(received->message, buffer + msg_content_index, received->message_size);
+    return true;
+}
+
+static bool ping_pong_on_fs_rb_message(uint8_t *const message, void *const context) {
+    struct ping_pong_received *const received = (struct ping_pong_received *) context;
+    memcpy(received->message, message, received->message_size);
+    return true;
+}
+
+static void ping_pong_receive(struct ping_pong_channel *const channel, uint8_t *const message) {
+    struct ping_pong_received received = {message, channel->message_size};
+    if (channel->queue == PING_PONG_VS_RB) {
+        while (vs_rb_read(&channel->vs_rb, channel->buffer, &ping_pong_on_vs_rb_message, 1, &received) == 0) {
+            __asm__ __volatile__("pause;");
+        }
+    } else {
+        while (fs_rb_read(channel->buffer, &channel->fs_rb, &ping_pong_on_fs_rb_message, 1, &received) == 0) {
+            __asm__ __volatile__("pause;");
+        }
+    }
+}
+
+static void *ping_pong_pong(void *arg) {
+    struct ping_pong *const ping_pong = (struct ping_pong *) arg;
+    const struct ping_pong_options *const options = ping_pong->options;
+    if (options->cpus[1] >= 0) {
+        bench_pin_current_thread(options->cpus[1]);
+    }
+    uint8_t *const message = calloc(1, options->message_size);
+    uint64_t sequence;
+    do {
+        ping_pong_receive(&ping_pong->request, message);
+        ping_pong_send(&ping_pong->response, message);
+        memcpy(&sequence, message, sizeof(sequence));
+    } while (sequence != PING_PONG_STOP);
+    free(message);
+    return NULL;
+}
+
+/**
+ * Send the pings and wait each pong, recording the round trip times.
+ * When the pings are sent at a fixed interval, a pong slower than the interval delays the next pings: {@code corrected}
+ * records the round trip times that the delayed pings would have had, to not hide the coordinated omission.
+ */
+static void ping_pong_ping(struct ping_pong *const ping_pong, struct histogram_t *const raw,
+                           struct histogram_t *const corrected) {
+    const struct ping_pong_options *const options = ping_pong->options;
+    if (options->cpus[0] >= 0) {
+        bench_pin_current_thread(options->cpus[0]);
+    }
+    uint8_t *const message = calloc(1, options->message_size);
+    uint8_t *const response = calloc(1, options->message_size);
+    const uint64_t total_messages = options->warmup_messages + options->messages;
+    uint64_t next_send_nanos = bench_nanos();
+    for (uint64_t sequence = 0; sequence < total_messages; sequence++) {
+        if (options->interval_nanos > 0) {
+            while (bench_nanos() < next_send_nanos) {
+                __asm__ __volatile__("pause;");
+            }
+            next_send_nanos += options->interval_nanos;
+        }
+        memcpy(message, &sequence, sizeof(sequence));
+        const uint64_t send_nanos = bench_nanos();
+        ping_pong_send(&ping_pong->request, message);
+        ping_pong_receive(&ping_pong->response, response);
+        const uint64_t rtt_nanos = bench_nanos() - send_nanos;
+        if (sequence >= options->warmup_messages) {
+            histogram_record(raw, rtt_nanos);
+            histogram_record_corrected(corrected, rtt_nanos, options->interval_nanos);
+        }
+    }
+    const uint64_t stop = PING_PONG_STOP;
+    memcpy(message, &stop, sizeof(stop));
+    ping_pong_send(&ping_pong->request, message);
+    ping_pong_receive(&ping_pong->response, response);
+    free(response);
+    free(message);
+}
+
+static void ping_pong_print(const struct ping_pong_options *const options, const char *const name,
+                            const struct histogram_t *const histogram) {
+    const char *const queue = options->queue == PING_PONG_VS_RB ? "vs_rb" : "fs_rb";
+    const char *const mode = options->processes ? "processes" : "threads";
+    if (options->csv) {
+        printf("%s,%s,%u,%lu,%s,%lu,%.1f,%lu", queue, mode, options->message_size, options->interval_nanos, name,
+               histogram->total_count, histogram_mean(histogram), histogram->min);
+        for (uint32_t i = 0; i < PING_PONG_PERCENTILES_COUNT; i++) {
+            printf(",%lu", histogram_value_at_percentile(histogram, PING_PONG_PERCENTILES[i]));
+        }
+        printf(",%lu\n", histogram->max);
+    } else {
+        printf("%s %s %u bytes rtt ns (%s): %lu samples mean %.0f min %lu", queue, mode, options->message_size, name,
+               histogram->total_count, histogram_mean(histogram), histogram->min);
+        for (uint32_t i = 0; i < PING_PONG_PERCENTILES_COUNT; i++) {
+            printf(" %s %lu", PING_PONG_PERCENTILE_NAMES[i],
+                   histogram_value_at_percentile(histogram, PING_PONG_PERCENTILES[i]));
+        }
+        printf(" max %lu\n", histogram->max);
+    }
+}
+
+static void ping_pong_usage(const char *const program) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -q, --queue <name>         vs_rb (default) or fs_rb\n"
+            "  -x, --processes            ping and pong in 2 processes over shared memory files\n"
+            "  -s, --message-size <b>     message size in bytes, at least 8 (default 16)\n"
+            "  -m, --messages <n>         measured round trips (default 1000000)\n"
+            "  -W, --warmup <n>           not measured round trips (default 100000)\n"
+            "  -i, --interval <ns>        send interval, 0 to send back to back (default 0)\n"
+            "  -a, --cpus <ping,pong>     cpus to pin ping and pong to\n"
+            "  -f, --format <format>      text (default) or csv\n",
+            program);
+}
+
+static bool ping_pong_parse_options(const int argc, char **const argv, struct ping_pong_options *const options) {
+    static const struct option long_options[] = {
+            {"queue",        required_argument, NULL, 'q'},
+            {"processes",    no_argument,       NULL, 'x'},
+            {"message-size", required_argument, NULL, 's'},
+            {"messages",     required_argument, NULL, 'm'},
+            {"warmup",       required_argument, NULL, 'W'},
+            {"interval",     required_argument, NULL, 'i'},
+            {"cpus",         required_argument, NULL, 'a'},
+            {"format",       required_argument, NULL, 'f'},
+            {"help",         no_argument,       NULL, 'h'},
+            {NULL, 0,                           NULL, 0}
+    };
+    options->queue = PING_PONG_VS_RB;
+    options->processes = false;
+    options->message_size = 16;
+    options->messages = 1000000;
+    options->warmup_messages = 100000;
+    options->interval_nanos = 0;
+    options->cpus[0] = -1;
+    options->cpus[1] = -1;
+    options->csv = false;
+    int option;
+    while ((option = getopt_long(argc, argv, "q:xs:m:W:i:a:f:h", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'q':
+                if (strcmp(optarg, "vs_rb") == 0) {
+                    options->queue = PING_PONG_VS_RB;
+                } else if (strcmp(optarg, "fs_rb") == 0) {
+                    options->queue = PING_PONG_FS_RB;
+                } else {
+                    return false;
+                }
+                break;
+            case 'x':
+                options->processes = true;
+                break;
+            case 's':
+                options->message_size = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'm':
+                options->messages = strtoull(optarg, NULL, 10);
+                break;
+            case 'W':
+                options->warmup_messages = strtoull(optarg, NULL, 10);
+                break;
+            case 'i':
+                options->interval_nanos = strtoull(optarg, NULL, 10);
+                break;
+            case 'a':
+                if (sscanf(optarg, "%d,%d", &options->cpus[0], &options->cpus[1]) != 2) {
+                    return false;
+                }
+                break;
+            case 'f':
+                if (strcmp(optarg, "csv") == 0) {
+                    options->csv = true;
+                } else if (strcmp(optarg, "text") != 0) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+    return optind == argc && options->message_size >= sizeof(uint64_t) && options->messages > 0;
+}
+
+int main(int argc, char **argv) {
+    struct ping_pong_options options;
+    if (!ping_pong_parse_options(argc, argv, &options)) {
+        ping_pong_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    struct ping_pong ping_pong;
+    ping_pong.options = &options;
+    if (!ping_pong_new_channel(&options, PING_PONG_REQUEST_PATH, &ping_pong.request) ||
+        !ping_pong_new_channel(&options, PING_PONG_RESPONSE_PATH, &ping_pong.response)) {
+        perror("ping_pong_new_channel");
+        return EXIT_FAILURE;
+    }
+    //the vs_rb capacity is fixed: a bigger message would never be claimed
+    if (options.queue == PING_PONG_VS_RB && options.message_size > (uint32_t) ping_pong.request.vs_rb.max_msg_length) {
+        fprintf(stderr, "the vs_rb message size can't be bigger than %d bytes\n",
+                ping_pong.request.vs_rb.max_msg_length);
+        ping_pong_usage(argv[0]);
+        ping_pong_close_channel(&options, &ping_pong.request);
+        ping_pong_close_channel(&options, &ping_pong.response);
+        if (options.processes) {
+            unlink(PING_PONG_REQUEST_PATH);
+            unlink(PING_PONG_RESPONSE_PATH);
+        }
+        return EXIT_FAILURE;
+    }
+    //each histogram is quite big: better on the heap
+    struct histogram_t *const raw = malloc(sizeof(struct histogram_t));
+    struct histogram_t *const corrected = malloc(sizeof(struct histogram_t));
+    new_histogram(raw);
+    new_histogram(corrected);
+    if (options.processes) {
+        const pid_t pong_pid = fork();
+        if (pong_pid < 0) {
+            perror("fork");
+            return EXIT_FAILURE;
+        }
+        if (pong_pid == 0) {
+            //the pong process attaches to the rings as any other process would do
+            struct ping_pong pong;
+            pong.options = &options;
+            shm_rb_close(&ping_pong.request.shm);
+            shm_rb_close(&ping_pong.response.shm);
+            if (!ping_pong_attach_channel(&options, PING_PONG_REQUEST_PATH, &pong.request) ||
+                !ping_pong_attach_channel(&options, PING_PONG_RESPONSE_PATH, &pong.response)) {
+                perror("ping_pong_attach_channel");
+                return EXIT_FAILURE;
+            }
+            ping_pong_pong(&pong);
+            ping_pong_close_channel(&options, &pong.request);
+            ping_pong_close_channel(&options, &pong.response);
+            return EXIT_SUCCESS;
+        }
+        ping_pong_ping(&ping_pong, raw, corrected);
+        waitpid(pong_pid, NULL, 0);
+        unlink(PING_PONG_REQUEST_PATH);
+        unlink(PING_PONG_RESPONSE_PATH);
+    } else {
+        pthread_t pong_thread;
+        pthread_create(&pong_thread, NULL, ping_pong_pong, &ping_pong);
+        ping_pong_ping(&ping_pong, raw, corrected);
+        pthread_join(pong_thread, NULL);
+    }
+    if (options.csv) {
+        printf("queue,mode,message_size,interval_ns,histogram,samples,rtt_mean_ns,rtt_min_ns");
+        for (uint32_t i = 0; i < PING_PONG_PERCENTILES_COUNT; i++) {
+            printf(",rtt_%s_ns", PING_PONG_PERCENTILE_NAMES[i]);
+        }
+        printf(",rtt_max_ns\n");
+    }
+    ping_pong_print(&options, "raw", raw);
+    ping_pong_print(&options, "corrected", corrected);
+    ping_pong_close_channel(&options, &ping_pong.request);
+    ping_pong_close_channel(&options, &ping_pong.response);
+    free(corrected);
+    free(raw);
+    return EXIT_SUCCESS;
+}
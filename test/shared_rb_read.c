@@ -5,11 +5,8 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <stdlib.h>
-#include "vs_rb.h"
-#include "vs_rb.c"
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/mman.h>
+#include "shm_rb.h"
+#include "shm_rb.c"
 
 #define DEFAULT_MSG_TYPE_ID 1
 #define DEFAULT_MSG_LENGTH 8
@@ -37,53 +34,15 @@ inline static bool on_message(const uint32_t msg_type_id, const uint8_t *buffer,
 
 int main() {
     struct vs_rb_t header;
-    const index_t buffer_capacity = vs_rb_capacity(128 * 1024 * vs_rb_required_record_capacity(DEFAULT_MSG_LENGTH));
-    if (!new_vs_rb(&header, buffer_capacity)) {
+    struct shm_rb_t shm;
+    const char *file_name = "/dev/shm/shared.ipc";
+    if (!shm_vs_rb_create(file_name, 128 * 1024 * vs_rb_required_record_capacity(DEFAULT_MSG_LENGTH), SHM_RB_POPULATE,
+                          &shm, &header)) {
+        perror("shm_vs_rb_create");
         return 1;
     }
 
-    char *mmap_bytes;
-    int fd;
-    char *file_name = "/dev/shm/shared.ipc";
-
-    fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, (mode_t) 0600);
-    if (fd == -1) {
-        perror("open");
-        return 1;
-    }
-    /* Stretch the file size to the size of the (mmapped) array of ints
- */
-    int result = lseek(fd, buffer_capacity - 1, SEEK_SET);
-    if (result == -1) {
-        close(fd);
-        perror("Error calling lseek() to 'stretch' the file");
-        exit(EXIT_FAILURE);
-    }
-
-    /* Something needs to be written at the end of the file to
-     * have the file actually have the new size.
-     * Just writing an empty string at the current file position will do.
-     *
-     * Note:
-     *  - The current position in the file is at the end of the stretched
-     *    file due to the call to lseek().
-     *  - An empty string is actually a single '\0' character, so a zero-byte
-     *    will be written at the last byte of the file.
-     */
-    result = write(fd, "", 1);
-
-    mmap_bytes = mmap(0, buffer_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (mmap_bytes == MAP_FAILED) {
-        perror("mmap");
-        return 1;
-    }
-
-    if (close(fd) == -1) {
-        perror("close");
-        return 1;
-    }
-
-    uint8_t *buffer = (uint8_t *) mmap_bytes;
+    uint8_t *buffer = shm.buffer;
 
     const uint64_t producers = 1;
     const uint64_t tests = 10;
@@ -109,7 +68,7 @@ int main() {
         printf("%ld/%ld failed reads\n", failed_read, total_messages);
     }
 
-    if (munmap(mmap_bytes, buffer_capacity) == -1) {
+    if (!shm_rb_close(&shm)) {
         perror("munmap");
         return 1;
     }
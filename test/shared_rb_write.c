@@ -6,52 +6,24 @@
 #include <inttypes.h>
 #include <pthread.h>
 #include <stdlib.h>
-#include "vs_rb.h"
-#include "vs_rb.c"
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/mman.h>
+#include "shm_rb.h"
+#include "shm_rb.c"
 
 #define DEFAULT_MSG_TYPE_ID 1
 #define DEFAULT_MSG_LENGTH 8
 
 int main() {
     struct vs_rb_t header;
-
-
-    char *mmap_bytes;
-    int fd;
-    char *file_name = "/dev/shm/shared.ipc";
-
-    fd = open(file_name, O_RDWR, (mode_t) 0600);
-    if (fd == -1) {
-        perror("open");
-        return 1;
-    }
-
-    struct stat st;
-    stat(file_name, &st);
-
-    const index_t buffer_capacity = st.st_size;
-    if (!new_vs_rb(&header, buffer_capacity)) {
-        return 1;
-    }
-
-    mmap_bytes = mmap(0, buffer_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (mmap_bytes == MAP_FAILED) {
-        perror("mmap");
-        return 1;
-    }
-
-    if (close(fd) == -1) {
-        perror("close");
+    struct shm_rb_t shm;
+    const char *file_name = "/dev/shm/shared.ipc";
+    if (!shm_vs_rb_attach(file_name, SHM_RB_POPULATE, &shm, &header)) {
+        perror("shm_vs_rb_attach");
         return 1;
     }
 
     const pthread_t thread_id = pthread_self();
 
-    uint8_t *buffer = (uint8_t *) mmap_bytes;
+    uint8_t *buffer = shm.buffer;
 
     const uint64_t tests = 10;
     const uint64_t messages = 100000000;
@@ -90,7 +62,7 @@ int main() {
         printf("[%ld]\t%ldM ops/sec %ld/%ld failed tries\n", thread_id, tpt, total_try - messages, (uint64_t) messages);
     }
 
-    if (munmap(mmap_bytes, buffer_capacity) == -1) {
+    if (!shm_rb_close(&shm)) {
         perror("munmap");
         return 1;
     }
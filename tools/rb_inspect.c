@@ -0,0 +1,302 @@
+//
+// Created by forked_franz on 18/10/26.
+//
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <time.h>
+#include "shm_rb.h"
+#include "shm_rb.c"
+
+#define RB_INSPECT_DEFAULT_HEX_BYTES 16
+
+/**
+ * Attaches read-only to a shared memory ring buffer and reports its state: it only loads the positions, the counters
+ * and (on request) the records between the consumer and the producer positions, hence it can't change the ring
+ * buffer state and the only cost paid by the producers/consumers is a periodic sharing of their cache lines.
+ */
+struct rb_inspect_options {
+    const char *path;                   /*  the ring buffer file                                                    */
+    uint64_t interval_millis;           /*  0 to report just once, the sampling interval otherwise                  */
+    uint64_t samples;                   /*  the samples to report when sampling, 0 to never stop                    */
+    uint32_t dump_records;              /*  max records to dump after the first report                              */
+    uint32_t hex_bytes;                 /*  max content bytes dumped for each record                                */
+};
+
+struct rb_inspect_ring {
+    struct shm_rb_t shm;
+    struct vs_rb_t vs_rb;
+    struct fs_rb_t fs_rb;
+};
+
+struct rb_inspect_sample {
+    uint64_t nanos;
+    uint64_t producer_position;
+    uint64_t consumer_position;
+};
+
+static void rb_inspect_usage(const char *const program) {
+    fprintf(stderr,
+            "usage: %s [options] <ring file>\n"
+            "  -i, --interval <ms>        sample the positions every <ms> milliseconds (default: report once)\n"
+            "  -n, --samples <n>          samples to report before exiting (default: never stop)\n"
+            "  -d, --dump <n>             dump up to <n> records between the consumer and the producer positions\n"
+            "  -x, --hex <b>              content bytes dumped for each record (default 16)\n",
+            program);
+}
+
+static bool rb_inspect_parse_options(const int argc, char **const argv, struct rb_inspect_options *const options) {
+    static const struct option long_options[] = {
+            {"interval", required_argument, NULL, 'i'},
+            {"samples",  required_argument, NULL, 'n'},
+            {"dump",     required_argument, NULL, 'd'},
+            {"hex",      required_argument, NULL, 'x'},
+            {"help",     no_argument,       NULL, 'h'},
+            {NULL, 0,                       NULL, 0}
+    };
+    options->path = NULL;
+    options->interval_millis = 0;
+    options->samples = 0;
+    options->dump_records = 0;
+    options->hex_bytes = RB_INSPECT_DEFAULT_HEX_BYTES;
+    int option;
+    while ((option = getopt_long(argc, argv, "i:n:d:x:h", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'i':
+                options->interval_millis = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                options->samples = strtoull(optarg, NULL, 10);
+                break;
+            case 'd':
+                options->dump_records = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'x':
+                options->hex_bytes = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            default:
+                return false;
+        }
+    }
+    if (optind != argc - 1) {
+        return false;
+    }
+    options->path = argv[optind];
+    return true;
+}
+
+static uint64_t rb_inspect_nanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000000ULL) + (uint64_t) now.tv_nsec;
+}
+
+static bool rb_inspect_attach(const char *const path, struct rb_inspect_ring *const ring) {
+    //the descriptor tells which layout is the right one: a wrong guess is refused on attach
+    if (shm_vs_rb_attach(path, SHM_RB_READ_ONLY, &ring->shm, &ring->vs_rb)) {
+        return true;
+    }
+    return shm_fs_rb_attach(path, SHM_RB_READ_ONLY, &ring->shm, &ring->fs_rb);
+}
+
+static void rb_inspect_load_sample(const struct rb_inspect_ring *const ring, struct rb_inspect_sample *const sample) {
+    uint8_t *const buffer = ring->shm.buffer;
+    sample->nanos = rb_inspect_nanos();
+    //the consumer is loaded first: it can't be ahead of a producer position loaded after it
+    if (ring->shm.layout == SHM_VS_RB_LAYOUT) {
+        sample->consumer_position = vs_rb_load_consumer_position(&ring->vs_rb, buffer);
+        sample->producer_position = vs_rb_load_producer_position(&ring->vs_rb, buffer);
+    } else {
+        sample->consumer_position = fs_rb_load_consumer_position(&ring->fs_rb, buffer);
+        sample->producer_position = fs_rb_load_producer_position(&ring->fs_rb, buffer);
+    }
+}
+
+static const uint8_t *rb_inspect_counters(const struct rb_inspect_ring *const ring) {
+    if (ring->shm.layout == SHM_VS_RB_LAYOUT) {
+        return vs_rb_counters(&ring->vs_rb, ring->shm.buffer);
+    }
+    return fs_rb_counters(&ring->fs_rb);
+}
+
+static void rb_inspect_print_description(const struct rb_inspect_ring *const ring) {
+    if (ring->shm.layout == SHM_VS_RB_LAYOUT) {
+        const bool wrap_mode = vs_rb_load_mode(&ring->vs_rb, ring->shm.buffer) == VS_RB_WRAP_MODE;
+        printf("layout=vs_rb length=%d capacity=%d bytes max_msg_length=%d mode=%s\n", ring->shm.length,
+               ring->vs_rb.capacity, ring->vs_rb.max_msg_length, wrap_mode ? "wrap" : "contiguous");
+    } else {
+        printf("layout=fs_rb length=%d capacity=%d messages message_size=%u\n", ring->shm.length,
+               ring->fs_rb.capacity, ring->fs_rb.aligned_message_size - MESSAGE_STATE_SIZE);
+    }
+}
+
+static void rb_inspect_print_counters(const struct rb_inspect_ring *const ring) {
+    static const enum rb_counter counters[] = {RB_CLAIMS, RB_FULL_CLAIMS, RB_PADDING_RECORDS,
+                                               RB_CONSUMER_CACHE_REFRESHES, RB_CAS_RETRIES, RB_READS,
+                                               RB_EMPTY_READS};
+    const uint8_t *const counters_address = rb_inspect_counters(ring);
+    printf("counters:");
+    for (uint32_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+        printf(" %s=%" PRIu64, rb_counter_name(counters[i]), rb_counter_load(counters_address, counters[i]));
+    }
+    printf("\n");
+}
+
+static void rb_inspect_print_sample(const struct rb_inspect_ring *const ring,
+                                    const struct rb_inspect_sample *const sample,
+                                    const struct rb_inspect_sample *const previous_sample) {
+    const bool vs_rb = ring->shm.layout == SHM_VS_RB_LAYOUT;
+    const uint64_t capacity = vs_rb ? (uint64_t) ring->vs_rb.capacity : (uint64_t) ring->fs_rb.capacity;
+    const uint64_t lag = sample->producer_position - sample->consumer_position;
+    printf("producer=%" PRIu64 " consumer=%" PRIu64 " lag=%" PRIu64 " %s fill=%.2f%%", sample->producer_position,
+           sample->consumer_position, lag, vs_rb ? "bytes" : "messages", (lag * 100.0) / capacity);
+    if (previous_sample != NULL) {
+        const double seconds = (sample->nanos - previous_sample->nanos) / 1e9;
+        const uint64_t produced = sample->producer_position - previous_sample->producer_position;
+        const uint64_t consumed = sample->consumer_position - previous_sample->consumer_position;
+        printf(" producer_rate=%.0f/s consumer_rate=%.0f/s", produced / seconds, consumed / seconds);
+        if (consumed == 0 && lag != 0) {
+            printf(" consumer_stalled");
+        }
+    }
+    printf("\n");
+}
+
+static void rb_inspect_print_hex(const struct iovec *const segments, const uint32_t segments_count,
+                                 const uint32_t hex_bytes) {
+    //the content of a record of a ring buffer in wrap mode can continue from the start of the buffer
+    uint32_t dumped_bytes = 0;
+    bool truncated = false;
+    for (uint32_t s = 0; s < segments_count; s++) {
+        const uint8_t *const content = (const uint8_t *) segments[s].iov_base;
+        for (size_t i = 0; i < segments[s].iov_len; i++) {
+            if (dumped_bytes == hex_bytes) {
+                truncated = true;
+                break;
+            }
+            printf("%s%02x", dumped_bytes == 0 ? " " : "", content[i]);
+            dumped_bytes++;
+        }
+    }
+    if (truncated) {
+        printf(" ...");
+    }
+}
+
+static void rb_inspect_dump_vs_rb(const struct rb_inspect_ring *const ring, const uint32_t dump_records,
+                                  const uint32_t hex_bytes) {
+    const struct vs_rb_t *const header = &ring->vs_rb;
+    const uint8_t *const buffer = ring->shm.buffer;
+    const index_t capacity = header->capacity;
+    const bool wrap_mode = vs_rb_load_mode(header, buffer) == VS_RB_WRAP_MODE;
+    const uint64_t consumer_position = vs_rb_load_consumer_position(header, buffer);
+    const uint64_t producer_position = vs_rb_load_producer_position(header, buffer);
+    uint64_t position = consumer_position;
+    uint32_t records = 0;
+    while (position < producer_position && records < dump_records) {
+        const index_t index = position & (capacity - 1);
+        const uint64_t msg_header = load_acquire_msg_header(buffer, index);
+        const index_t length = record_length(msg_header);
+        if (length <= 0) {
+            //a claimed record not committed yet blocks the consumer: the most likely reason of a stall
+            printf("%" PRIu64 " @%d: claimed, not committed\n", position, index);
+            break;
+        }
+        if (length < RECORD_HEADER_LENGTH || length > (wrap_mode ? capacity : capacity - index)) {
+            printf("%" PRIu64 " @%d: invalid record length %d\n", position, index, length);
+            break;
+        }
+        const uint32_t msg_type_id = message_type_id(msg_header);
+        if (msg_type_id == RECORD_PADDING_MSG_TYPE_ID) {
+            printf("%" PRIu64 " @%d: padding length=%d\n", position, index, length);
+        } else {
+            const index_t msg_content_length = length - RECORD_HEADER_LENGTH;
+            struct iovec segments[VS_RB_MAX_SEGMENTS];
+            const uint32_t segments_count = vs_rb_record_segments(header, buffer, index, msg_content_length, segments);
+            printf("%" PRIu64 " @%d: type=%u length=%d%s", position, index, msg_type_id, msg_content_length,
+                   segments_count > 1 ? " wrapped" : "");
+            rb_inspect_print_hex(segments, segments_count, hex_bytes);
+            printf("\n");
+        }
+        position += align(length, RECORD_ALIGNMENT);
+        records++;
+    }
+    if (vs_rb_load_consumer_position(header, buffer) != consumer_position) {
+        printf("the consumer has moved during the dump: the records could be already zeroed\n");
+    }
+}
+
+static void rb_inspect_dump_fs_rb(const struct rb_inspect_ring *const ring, const uint32_t dump_records,
+                                  const uint32_t hex_bytes) {
+    const struct fs_rb_t *const header = &ring->fs_rb;
+    const uint8_t *const buffer = ring->shm.buffer;
+    const index_t message_size = header->aligned_message_size - MESSAGE_STATE_SIZE;
+    const uint64_t consumer_position = fs_rb_load_consumer_position(header, buffer);
+    const uint64_t producer_position = fs_rb_load_producer_position(header, buffer);
+    uint32_t records = 0;
+    for (uint64_t position = consumer_position; position < producer_position && records < dump_records; position++) {
+        const index_t index = (position & header->mask) * header->aligned_message_size;
+        const uint32_t message_state = atomic_load_explicit((_Atomic uint32_t *) (buffer + index),
+                                                            memory_order_acquire);
+        if (message_state == MESSAGE_STATE_FREE) {
+            printf("%" PRIu64 " @%d: claimed, not committed\n", position, index);
+        } else {
+            const struct iovec content = {.iov_base = (uint8_t *) buffer + index + MESSAGE_STATE_SIZE,
+                                          .iov_len = message_size};
+            printf("%" PRIu64 " @%d: committed", position, index);
+            rb_inspect_print_hex(&content, 1, hex_bytes);
+            printf("\n");
+        }
+        records++;
+    }
+    if (fs_rb_load_consumer_position(header, buffer) != consumer_position) {
+        printf("the consumer has moved during the dump: the messages could be already freed\n");
+    }
+}
+
+static void rb_inspect_sleep_millis(const uint64_t millis) {
+    const struct timespec interval = {.tv_sec = millis / 1000, .tv_nsec = (millis % 1000) * 1000000};
+    nanosleep(&interval, NULL);
+}
+
+int main(int argc, char **argv) {
+    struct rb_inspect_options options;
+    if (!rb_inspect_parse_options(argc, argv, &options)) {
+        rb_inspect_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    struct rb_inspect_ring ring;
+    if (!rb_inspect_attach(options.path, &ring)) {
+        fprintf(stderr, "%s is not a vs_rb or a fs_rb ring file\n", options.path);
+        return EXIT_FAILURE;
+    }
+    rb_inspect_print_description(&ring);
+    struct rb_inspect_sample sample;
+    rb_inspect_load_sample(&ring, &sample);
+    rb_inspect_print_sample(&ring, &sample, NULL);
+    rb_inspect_print_counters(&ring);
+    if (options.dump_records > 0) {
+        if (ring.shm.layout == SHM_VS_RB_LAYOUT) {
+            rb_inspect_dump_vs_rb(&ring, options.dump_records, options.hex_bytes);
+        } else {
+            rb_inspect_dump_fs_rb(&ring, options.dump_records, options.hex_bytes);
+        }
+    }
+    if (options.interval_millis > 0) {
+        for (uint64_t samples = 1; options.samples == 0 || samples < options.samples; samples++) {
+            const struct rb_inspect_sample previous_sample = sample;
+            rb_inspect_sleep_millis(options.interval_millis);
+            rb_inspect_load_sample(&ring, &sample);
+            rb_inspect_print_sample(&ring, &sample, &previous_sample);
+            fflush(stdout);
+        }
+        rb_inspect_print_counters(&ring);
+    }
+    shm_rb_close(&ring.shm);
+    return EXIT_SUCCESS;
+}